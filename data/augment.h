@@ -0,0 +1,55 @@
+#ifndef DEEP_LEARNING_AUGMENT_H
+#define DEEP_LEARNING_AUGMENT_H
+
+#include <cstdint>
+#include "../src/Matrix.h"
+#include "../src/Random/Philox.h"
+
+// On-the-fly augmentation of one (1, rows * cols) image as loaded by LoadData: a random
+// translation of up to max_shift pixels in each direction, padded with the background
+// value, plus optional gaussian pixel noise.
+//
+// All the randomness of a sample comes from Philox stream (epoch, sample), so the
+// augmented batch does not depend on which thread prepared which image. Epoch 0 uses
+// the low stream numbers, so seed must be a key nothing else draws from.
+template <typename T>
+matrix::Matrix<T> Augment(const matrix::Matrix<T> & img,
+                          size_t rows,
+                          size_t cols,
+                          size_t max_shift,
+                          T noise_stddev,
+                          uint64_t seed,
+                          uint64_t epoch,
+                          uint64_t sample) {
+    assert(img.size == rows * cols);
+    const uint64_t stream = (epoch << 32) ^ sample;
+    uint32_t words[4];
+    rng::Philox philox(seed);
+    philox(stream, 0, words);
+    const long span = 2 * (long)max_shift + 1;
+    const long dy = (long)(words[0] % span) - (long)max_shift;
+    const long dx = (long)(words[1] % span) - (long)max_shift;
+
+    // pixel 0 is encoded as (0 - 128) / 255 by LoadData
+    const T background = (T)(-128.0 / 255.0);
+    matrix::Matrix<T> res(img.nrow, img.ncol, false);
+    const T * in = img.data();
+    T * out = res.data();
+    if (noise_stddev > 0) {
+        // a sibling stream, so the noise never reuses the words that picked the shift
+        rng::FillNormal(out, res.size, (T)0, noise_stddev, seed, stream ^ ((uint64_t)1 << 63), 1);
+    } else {
+        res.setZero();
+    }
+    for (long r = 0; r < (long)rows; ++r) {
+        const long sr = r - dy;
+        for (long c = 0; c < (long)cols; ++c) {
+            const long sc = c - dx;
+            bool inside = sr >= 0 && sr < (long)rows && sc >= 0 && sc < (long)cols;
+            out[r * cols + c] += inside ? in[sr * cols + sc] : background;
+        }
+    }
+    return res;
+}
+
+#endif //DEEP_LEARNING_AUGMENT_H
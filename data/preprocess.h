@@ -5,11 +5,59 @@
 #ifndef DEEP_LEARNING_PREPROCESS_H
 #define DEEP_LEARNING_PREPROCESS_H
 
+#include <cmath>
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
 
 
+// Every 3 base-41 digits ('0' + d) of strLine encode two 8-bit pixels p, scaled to (p - 128) / 255.
+// Returns false if strLine is too short or holds an invalid digit or code.
+template<typename T>
+bool DecodeImage(const std::string & strLine, size_t nImgArea, std::vector<T> & fltBuf) {
+    const size_t n = 41;
+    if (strLine.size() < nImgArea / 2 * 3) {
+        return false;
+    }
+    fltBuf.resize(nImgArea);
+    for (size_t j = 0; j < nImgArea / 2; ++j) {
+        const char *p = strLine.c_str() + j * 3;
+        for (size_t d = 0; d < 3; ++d) {
+            if (p[d] < '0' || p[d] >= (char) ('0' + n)) {
+                return false;
+            }
+        }
+        size_t rawCode = (size_t) (p[0] - '0') * n * n;
+        rawCode += (size_t) (p[1] - '0') * n;
+        rawCode += (size_t) (p[2] - '0');
+        if (rawCode > 0xFFFF) {
+            return false;
+        }
+        fltBuf[j * 2 + 0] = ((rawCode & 0xFF) - 128.0f) / 255.0f;
+        fltBuf[j * 2 + 1] = ((rawCode >> 8) - 128.0f) / 255.0f;
+    }
+    return true;
+}
+
+// inverse of DecodeImage
+template<typename T>
+std::string EncodeImage(const std::vector<T> & fltBuf) {
+    const size_t n = 41;
+    std::string strLine(fltBuf.size() / 2 * 3, '0');
+    for (size_t j = 0; j < fltBuf.size() / 2; ++j) {
+        size_t lo = (size_t) std::lround(fltBuf[j * 2 + 0] * 255.0f + 128.0f);
+        size_t hi = (size_t) std::lround(fltBuf[j * 2 + 1] * 255.0f + 128.0f);
+        size_t rawCode = (hi << 8) | lo;
+        strLine[j * 3 + 0] = (char) ('0' + rawCode / (n * n));
+        strLine[j * 3 + 1] = (char) ('0' + rawCode / n % n);
+        strLine[j * 3 + 2] = (char) ('0' + rawCode % n);
+    }
+    return strLine;
+}
+
+// Throws std::runtime_error naming the first sample whose line does not decode.
 template<typename _IS, typename T>
 void LoadData(_IS &inStream,
               size_t & pImgRows,
@@ -19,7 +67,7 @@ void LoadData(_IS &inStream,
               std::vector<std::vector<T>> & testImages) {
     size_t nTrainCnt, nTestCnt;
     inStream >> nTrainCnt >> nTestCnt >> pImgRows >> pImgCols;
-    size_t nImgArea = pImgRows * pImgCols, n = 41;
+    size_t nImgArea = pImgRows * pImgCols;
     trainImages.resize(nTrainCnt);
     trainLabels.resize(nTrainCnt);
     testImages.resize(nTestCnt);
@@ -27,13 +75,9 @@ void LoadData(_IS &inStream,
         std::string strLine;
         inStream >> strLine;
         std::vector<T> fltBuf(nImgArea);
-        for (size_t j = 0; j < nImgArea / 2; ++j) {
-            const char *p = strLine.c_str() + j * 3;
-            size_t rawCode = (uint16_t) (p[0] - '0') * n * n;
-            rawCode += (size_t) (p[1] - '0') * n;
-            rawCode += (size_t) (p[2] - '0');
-            fltBuf[j * 2 + 0] = ((rawCode & 0xFF) - 128.0f) / 255.0f;
-            fltBuf[j * 2 + 1] = ((rawCode >> 8) - 128.0f) / 255.0f;
+        if (!DecodeImage(strLine, nImgArea, fltBuf)) {
+            throw std::runtime_error("LoadData: sample " + std::to_string(i) +
+                                     " is not a valid base-41 image of " + std::to_string(nImgArea) + " pixels");
         }
         if (i < nTrainCnt) {
             fltBuf.swap(trainImages[i]);
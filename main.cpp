@@ -1,13 +1,30 @@
 #include <random>
+#include <chrono>
 #include <vector>
+#include <sstream>
 #include <fstream>
 #include <iostream>
 #include "src/Matrix.h"
 #include "src/Loss/Loss.h"
 #include "data/preprocess.h"
+#include "data/augment.h"
 #include "src/Layer/DenseLayer.h"
+#include "src/Layer/FixedDenseLayer.h"
+#include "src/Layer/Conv2DLayer.h"
+#include "src/Layer/PoolingLayer.h"
+#include "src/Layer/DropoutLayer.h"
 #include "src/ActiveFunc/ActiveFun.h"
 #include "src/Optimization/Optimization.h"
+#include "src/Optimization/MiniBatch.h"
+#include "src/Optimization/Hogwild.h"
+#include "src/Distributed/Launcher.h"
+#include "src/Distributed/ShmTransport.h"
+#include "src/Evaluation/Evaluator.h"
+#include "src/Reduction/Reduction.h"
+#include "src/Random/Philox.h"
+#include "src/Sweep/SweepRunner.h"
+#include "src/Serving/PredictionServer.h"
+#include "src/Serving/LoadGenerator.h"
 #include <Eigen/Eigen>
 
 using namespace std;
@@ -164,6 +181,17 @@ void test_load_data() {
     //x_test.print();
 }
 
+// random training images, one per column of batchImgs, and their labels
+void RandomBatch(const matrix::Matrix<float> & x_train, const matrix::Matrix<float> & y_train,
+                 matrix::Matrix<float> & batchImgs, vector<size_t> & labels) {
+    for (size_t b = 0; b < labels.size(); ++b) {
+        // Random SGD
+        size_t iImg = random() % x_train.nrow;
+        batchImgs.setCol(b, x_train(iImg));
+        labels[b] = (size_t)y_train(iImg, 0);
+    }
+}
+
 void test_dnn() {
     clock_t start = clock();
     size_t nImgRows, nImgCols;
@@ -191,85 +219,857 @@ void test_dnn() {
     DenseLayer<float> fc1(nImgArea, fc1In, genNormRand), fc2(fc1In, fc2In, genNormRand);
     Tanh<float> act;
     SoftMaxLoss<float> loss;
+    MiniBatchStep<float, Tanh> sgd(fc1, fc2);
+
+    matrix::Matrix<float> batchImgs(nImgArea, nBatchSize, false);
+    vector<size_t> labels(nBatchSize);
+    size_t iter;
+    for (iter = 0; iter < maxIter; ++iter) {
+        for (size_t iImgdx = 0; iImgdx < x_train.nrow; iImgdx += nBatchSize) {
+            RandomBatch(x_train, y_train, batchImgs, labels);
+            sgd.Train(batchImgs, labels, lr);
+            cout << "loss = " << sgd.loss_ << "\tprecision = " << sgd.precision_ << endl;
+        }
+    }
+
+    std::ifstream testLabelFileStream("../data/label_2000a.txt");
+    vector<float> testLabel;
+    testLabel.resize(500);
+    for (uint32_t i = 0; i < 500; i++) {
+        testLabelFileStream >> testLabel[i];
+    }
+
+    float fLossSum = 0.0f, fLoss;
+    uint32_t nCorrected = 0;
+    for (uint32_t i = 0; i < testImgs.size(); i++) {
+        fc1.Forward(x_test(i).t());
+        matrix::Matrix<float> outputs_ = act.Forward(fc1.outputs_); //a_fc1
+        fc2.Forward(outputs_);
+        auto label = (size_t)testLabel[i];
+        size_t nPred = loss.Forward(fc2.outputs_, label, fLoss);
+
+        fLossSum += fLoss;
+        nCorrected += (nPred == label);
+    }
+    std::cout << "[test] " << "loss = " << fLossSum / testImgs.size() << " accuracy = "
+              << (float)nCorrected / testImgs.size() << std::endl;
+
+    std::cout << "Duration: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s " << "for " << iter
+              << " times durations" << std::endl;
+}
+
+// the train_2000a images and labels with the 500 test labels of label_2000a
+struct Dataset {
+    size_t nImgRows, nImgCols, nImgArea;
+    vector<vector<float> > trainImgs, testImgs;
+    vector<float> trainLabels, testLabel;
+    matrix::Matrix<float> x_train, y_train, x_test;
+
+    Dataset() : x_train(0, 0), y_train(0, 0), x_test(0, 0) {}
+};
+
+Dataset LoadDataset() {
+    Dataset dataset;
+    ifstream trainFileStram("../data/train_2000a.txt");
+    LoadData(trainFileStram, dataset.nImgRows, dataset.nImgCols, dataset.trainImgs, dataset.trainLabels,
+             dataset.testImgs);
+    dataset.nImgArea = dataset.nImgRows * dataset.nImgCols;
+    dataset.x_train = matrix::Matrix<float>(dataset.trainImgs);
+    dataset.y_train = matrix::Matrix<float>(dataset.trainLabels, false);
+    dataset.x_test = matrix::Matrix<float>(dataset.testImgs);
+
+    std::ifstream testLabelFileStream("../data/label_2000a.txt");
+    dataset.testLabel.resize(500);
+    for (uint32_t i = 0; i < 500; i++) {
+        testLabelFileStream >> dataset.testLabel[i];
+    }
+    return dataset;
+}
+
+void test_fixed_dnn() {
+    clock_t start = clock();
+    Dataset dataset = LoadDataset();
+
+    // the small output layer and the loss are sized at compile time
+    const size_t fc1In = 28;
+    const size_t fc2In = 10;
+    size_t maxIter = 4;
+    float lr = 0.05;
+    size_t nBatchSize = 64;
+
+    std::random_device rd;
+    std::mt19937 rg(rd());
+    std::normal_distribution<float> normDist(0, 0.1);
+    auto genNormRand = [&]() { return normDist(rg); };
+    DenseLayer<float> fc1(dataset.nImgArea, fc1In, genNormRand);
+    FixedDenseLayer<float, fc1In, fc2In> fc2(genNormRand);
+    Tanh<float> act;
+    FixedSoftMaxLoss<float, fc2In> loss;
     GradientDescent<float> opt;
 
     matrix::Matrix<float> loss_weights_(0, 0);
+    FixedDenseLayer<float, fc1In, fc2In>::Vector fc2_active_grads_(false);
+    fc2_active_grads_.setOnes();
     size_t iter;
     for (iter = 0; iter < maxIter; ++iter) {
-        for (size_t iImgdx = 0; iImgdx < x_train.nrow; iImgdx += nBatchSize) {
+        for (size_t iImgdx = 0; iImgdx < dataset.x_train.nrow; iImgdx += nBatchSize) {
             float fLossSum = 0.0f, fLoss;
             size_t nCorrected = 0;
 
-            matrix::Matrix<float> fc1WeightsGrads(fc1In, nImgArea);
-            matrix::Matrix<float> fc1BiasGrads(fc1In, 1);
-            matrix::Matrix<float> fc2WeightsGrads(fc2In, fc1In);
-            matrix::Matrix<float> fc2BiasGrads(fc2In, 1);
+            // the dynamic first layer takes the batched gradient of MiniBatchStep; the fixed-shape
+            // second layer works on one sample at a time by design
+            matrix::Matrix<float> batchImgs(dataset.nImgArea, nBatchSize, false);
+            matrix::Matrix<float> fc1Deltas(fc1In, nBatchSize, false);
+            matrix::FixedMatrix<float, fc2In, fc1In> fc2WeightsGrads;
+            matrix::FixedMatrix<float, fc2In, 1> fc2BiasGrads;
 
             for (size_t iBatch = 0; iBatch < nBatchSize; ++iBatch) {
                 // Random SGD
-                size_t iImg = random() % trainImgs.size();
-                //cout << "img: " << iImg << endl;
+                size_t iImg = random() % dataset.trainImgs.size();
 
                 // forward
-                matrix::Matrix<float> img = x_train(iImg);
+                matrix::Matrix<float> img = dataset.x_train(iImg);
                 fc1.Forward(img.t());
 
-                matrix::Matrix<float> outputs_ = act.Forward(fc1.outputs_); //a_fc1
+                matrix::FixedMatrix<float, fc1In, 1> outputs_(act.Forward(fc1.outputs_)); //a_fc1
                 fc2.Forward(outputs_);
-                size_t nPred = loss.Forward(fc2.outputs_, (size_t)y_train(iImg, 0), fLoss);
+                size_t nPred = loss.Forward(fc2.outputs_, (size_t)dataset.y_train(iImg, 0), fLoss);
 
                 // backward
-
-                matrix::Matrix<float> loss_grads_ = loss.grad_();
-
-                matrix::Matrix<float> fc2_active_grads_(fc2In, 1, false);
-                fc2_active_grads_.setOnes();
-                fc2.Backward(loss_weights_, loss_grads_, fc2_active_grads_);
+                fc2.Backward(loss.grad_(), fc2_active_grads_);
+                matrix::Matrix<float> fc2_input_grads_ = fc2.InputGrads().toMatrix();
                 matrix::Matrix<float> act_grads = act.grad_();
-                fc1.Backward(fc2.weights_, fc2.grads_, act_grads);
+                fc1.Backward(loss_weights_, fc2_input_grads_, act_grads);
 
                 fLossSum += fLoss;
-                nCorrected += (nPred == y_train(iImg, 0));
+                nCorrected += (nPred == dataset.y_train(iImg, 0));
 
-                fc1WeightsGrads += fc1.grads_.dot(img);
-                fc1BiasGrads += fc1.grads_;
+                batchImgs.setCol(iBatch, img);
+                fc1Deltas.setCol(iBatch, fc1.grads_);
                 fc2WeightsGrads += fc2.grads_.dot(outputs_.t());
                 fc2BiasGrads += fc2.grads_;
             }
+            matrix::Matrix<float> fc1WeightsGrads = fc1Deltas.dot(batchImgs, false, true);
+            matrix::Matrix<float> fc1BiasGrads = fc1Deltas.sum(1);
 
             cout << "loss = " << fLossSum / (float)nBatchSize << "\tprecision = " << nCorrected / (float)nBatchSize << endl;
 
             opt.Update(fc1.weights_, fc1.bias_, fc1WeightsGrads, fc1BiasGrads, lr / (float)nBatchSize);
-            opt.Update(fc2.weights_, fc2.bias_, fc2WeightsGrads, fc2BiasGrads, lr / (float)nBatchSize);
+            fc2.weights_ -= fc2WeightsGrads * (lr / (float)nBatchSize);
+            fc2.bias_ -= fc2BiasGrads * (lr / (float)nBatchSize);
         }
     }
 
-    std::ifstream testLabelFileStream("../data/label_2000a.txt");
-    vector<float> testLabel;
-    testLabel.resize(500);
-    for (uint32_t i = 0; i < 500; i++) {
-        testLabelFileStream >> testLabel[i];
+    float fLossSum = 0.0f, fLoss;
+    uint32_t nCorrected = 0;
+    for (uint32_t i = 0; i < dataset.testImgs.size(); i++) {
+        fc1.Forward(dataset.x_test(i).t());
+        matrix::FixedMatrix<float, fc1In, 1> outputs_(act.Forward(fc1.outputs_)); //a_fc1
+        fc2.Forward(outputs_);
+        auto label = (size_t)dataset.testLabel[i];
+        size_t nPred = loss.Forward(fc2.outputs_, label, fLoss);
+
+        fLossSum += fLoss;
+        nCorrected += (nPred == label);
+    }
+    std::cout << "[test] " << "loss = " << fLossSum / dataset.testImgs.size() << " accuracy = "
+              << (float)nCorrected / dataset.testImgs.size() << std::endl;
+
+    std::cout << "Duration: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s " << "for " << iter
+              << " times durations" << std::endl;
+}
+
+void test_cnn() {
+    clock_t start = clock();
+    Dataset dataset = LoadDataset();
+
+    size_t nChannels = 6;
+    size_t nKernelSize = 5;
+    size_t nPoolSize = 2;
+    size_t fcIn = 10;
+    size_t maxIter = 4;
+    float lr = 0.05;
+    size_t nBatchSize = 64;
+
+    std::random_device rd;
+    std::mt19937 rg(rd());
+    std::normal_distribution<float> normDist(0, 0.1);
+    auto genNormRand = [&]() { return normDist(rg); };
+    Conv2DLayer<float> conv1(1, nChannels, dataset.nImgRows, dataset.nImgCols, nKernelSize, 1, 0, genNormRand);
+    MaxPool2DLayer<float> pool1(nChannels, conv1.out_rows, conv1.out_cols, nPoolSize);
+    size_t nFlatten = nChannels * pool1.out_rows * pool1.out_cols;
+    DenseLayer<float> fc1(nFlatten, fcIn, genNormRand);
+    Tanh<float> act;
+    SoftMaxLoss<float> loss;
+    GradientDescent<float> opt;
+
+    matrix::Matrix<float> loss_weights_(0, 0);
+    matrix::Matrix<float> fc1_active_grads_(fcIn, 1, false);
+    fc1_active_grads_.setOnes();
+    size_t iter;
+    for (iter = 0; iter < maxIter; ++iter) {
+        for (size_t iImgdx = 0; iImgdx < dataset.x_train.nrow; iImgdx += nBatchSize) {
+            float fLossSum = 0.0f, fLoss;
+            size_t nCorrected = 0;
+
+            matrix::Matrix<float> conv1WeightsGrads(conv1.weights_.nrow, conv1.weights_.ncol);
+            matrix::Matrix<float> conv1BiasGrads(nChannels, 1);
+            matrix::Matrix<float> fc1WeightsGrads(fcIn, nFlatten);
+            matrix::Matrix<float> fc1BiasGrads(fcIn, 1);
+
+            for (size_t iBatch = 0; iBatch < nBatchSize; ++iBatch) {
+                // Random SGD
+                size_t iImg = random() % dataset.trainImgs.size();
+
+                // forward
+                conv1.Forward(dataset.x_train(iImg));
+                matrix::Matrix<float> conv1_outputs_ = act.Forward(conv1.outputs_); //a_conv1
+                pool1.Forward(conv1_outputs_);
+                matrix::Matrix<float> flatten = pool1.outputs_.reshape(nFlatten, 1);
+                fc1.Forward(flatten);
+                size_t nPred = loss.Forward(fc1.outputs_, (size_t)dataset.y_train(iImg, 0), fLoss);
+
+                // backward
+                matrix::Matrix<float> loss_grads_ = loss.grad_();
+                fc1.Backward(loss_weights_, loss_grads_, fc1_active_grads_);
+                matrix::Matrix<float> pool1_grads_ = fc1.weights_.t().dot(fc1.grads_).reshape(nChannels, pool1.out_rows * pool1.out_cols);
+                pool1.Backward(pool1_grads_);
+                conv1.Backward(pool1.input_grads_, act.grad_());
+
+                fLossSum += fLoss;
+                nCorrected += (nPred == dataset.y_train(iImg, 0));
+
+                conv1WeightsGrads += conv1.weights_grads_;
+                conv1BiasGrads += conv1.bias_grads_;
+                fc1WeightsGrads += fc1.grads_.dot(flatten.t());
+                fc1BiasGrads += fc1.grads_;
+            }
+
+            cout << "loss = " << fLossSum / (float)nBatchSize << "\tprecision = " << nCorrected / (float)nBatchSize << endl;
+
+            opt.Update(conv1.weights_, conv1.bias_, conv1WeightsGrads, conv1BiasGrads, lr / (float)nBatchSize);
+            opt.Update(fc1.weights_, fc1.bias_, fc1WeightsGrads, fc1BiasGrads, lr / (float)nBatchSize);
+        }
     }
 
     float fLossSum = 0.0f, fLoss;
     uint32_t nCorrected = 0;
-    for (uint32_t i = 0; i < testImgs.size(); i++) {
-        fc1.Forward(x_test(i).t());
-        matrix::Matrix<float> outputs_ = act.Forward(fc1.outputs_); //a_fc1
-        fc2.Forward(outputs_);
-        auto label = (size_t)testLabel[i];
+    for (uint32_t i = 0; i < dataset.testImgs.size(); i++) {
+        conv1.Forward(dataset.x_test(i));
+        pool1.Forward(act.Forward(conv1.outputs_));
+        fc1.Forward(pool1.outputs_.reshape(nFlatten, 1));
+        auto label = (size_t)dataset.testLabel[i];
+        size_t nPred = loss.Forward(fc1.outputs_, label, fLoss);
+
+        fLossSum += fLoss;
+        nCorrected += (nPred == label);
+    }
+    std::cout << "[test] " << "loss = " << fLossSum / dataset.testImgs.size() << " accuracy = "
+              << (float)nCorrected / dataset.testImgs.size() << std::endl;
+
+    std::cout << "Duration: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s " << "for " << iter
+              << " times durations" << std::endl;
+}
+
+void test_hogwild() {
+    Dataset dataset = LoadDataset();
+
+    size_t fc1In = 28;
+    size_t fc2In = 10;
+    size_t maxIter = 4;
+    float lr = 0.05;
+    size_t nBatchSize = 64;
+    // Hogwild applies every sample on its own, so it takes smaller steps than a batch update
+    float hogwildLr = 0.01;
+
+    auto evaluate = [&](DenseLayer<float> & fc1, DenseLayer<float> & fc2) {
+        Tanh<float> act;
+        SoftMaxLoss<float> loss;
+        float fLoss;
+        uint32_t nCorrected = 0;
+        for (uint32_t i = 0; i < dataset.testImgs.size(); i++) {
+            fc1.Forward(dataset.x_test(i).t());
+            matrix::Matrix<float> outputs_ = act.Forward(fc1.outputs_); //a_fc1
+            fc2.Forward(outputs_);
+            auto label = (size_t)dataset.testLabel[i];
+            nCorrected += (loss.Forward(fc2.outputs_, label, fLoss) == label);
+        }
+        return (float)nCorrected / dataset.testImgs.size();
+    };
+
+    // serial baseline: the mini-batch loop of test_dnn, from the initial weights of the Hogwild runs
+    double serialThroughput;
+    {
+        std::mt19937 rg(2018);
+        std::normal_distribution<float> normDist(0, 0.1);
+        auto genNormRand = [&]() { return normDist(rg); };
+        DenseLayer<float> fc1(dataset.nImgArea, fc1In, genNormRand), fc2(fc1In, fc2In, genNormRand);
+        MiniBatchStep<float, Tanh> sgd(fc1, fc2);
+        matrix::Matrix<float> batchImgs(dataset.nImgArea, nBatchSize, false);
+        vector<size_t> labels(nBatchSize);
+        size_t nSteps = (dataset.x_train.nrow + nBatchSize - 1) / nBatchSize;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t iter = 0; iter < maxIter; ++iter) {
+            float fLossSum = 0.0f;
+            for (size_t iImgdx = 0; iImgdx < dataset.x_train.nrow; iImgdx += nBatchSize) {
+                RandomBatch(dataset.x_train, dataset.y_train, batchImgs, labels);
+                sgd.Train(batchImgs, labels, lr);
+                fLossSum += sgd.loss_;
+            }
+            cout << "[serial] iter " << iter << " loss = " << fLossSum / nSteps << endl;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        serialThroughput = maxIter * nSteps * nBatchSize / seconds;
+        cout << "[serial] accuracy = " << evaluate(fc1, fc2) << "\t" << serialThroughput << " samples/s" << endl;
+    }
+
+    // asynchronous runs with a growing number of threads, all from the same initial weights
+    double baseThroughput = 0;
+    for (size_t nThreads : {1, 2, 4, 8}) {
+        std::mt19937 rg(2018);
+        std::normal_distribution<float> normDist(0, 0.1);
+        auto genNormRand = [&]() { return normDist(rg); };
+        DenseLayer<float> fc1(dataset.nImgArea, fc1In, genNormRand), fc2(fc1In, fc2In, genNormRand);
+        Hogwild<float, Tanh> hogwild(fc1, fc2, nThreads);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t iter = 0; iter < maxIter; ++iter) {
+            hogwild.Train(dataset.x_train, dataset.y_train, dataset.x_train.nrow, hogwildLr, (unsigned)(iter * 1000));
+            cout << "[hogwild x" << nThreads << "] iter " << iter << " loss = " << hogwild.loss_
+                 << "\tprecision = " << hogwild.precision_ << endl;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double throughput = maxIter * dataset.x_train.nrow / seconds;
+        if (nThreads == 1) {
+            baseThroughput = throughput;
+        }
+        cout << "[hogwild x" << nThreads << "] accuracy = " << evaluate(fc1, fc2) << "\t" << throughput
+             << " samples/s\tspeedup = " << throughput / baseThroughput << "x (vs serial "
+             << throughput / serialThroughput << "x)" << endl;
+    }
+}
+
+void test_data_parallel() {
+    Dataset dataset = LoadDataset();
+
+    size_t fc1In = 28;
+    size_t fc2In = 10;
+    size_t maxIter = 4;
+    float lr = 0.05;
+    // global batch, split over the workers
+    size_t nBatchSize = 64;
+    size_t nSteps = (dataset.x_train.nrow + nBatchSize - 1) / nBatchSize;
+
+    // fc1 weights/bias, fc2 weights/bias, then the batch loss sum and correct count
+    size_t nParams = fc1In * dataset.nImgArea + fc1In + fc2In * fc1In + fc2In;
+    size_t nReduce = nParams + 2;
+
+    double baseSeconds = 0;
+    for (size_t nWorkers : {1, 2, 4}) {
+        // every worker inherits the same initial weights through fork
+        std::mt19937 rg(2018);
+        std::normal_distribution<float> normDist(0, 0.1);
+        auto genNormRand = [&]() { return normDist(rg); };
+        DenseLayer<float> fc1(dataset.nImgArea, fc1In, genNormRand), fc2(fc1In, fc2In, genNormRand);
+        ShmTransport<float> transport(nWorkers, nReduce);
+
+        auto worker = [&](size_t rank) {
+            transport.Attach(rank);
+            size_t nShardBegin = rank * dataset.x_train.nrow / nWorkers;
+            size_t nShardSize = (rank + 1) * dataset.x_train.nrow / nWorkers - nShardBegin;
+            size_t nLocalBatch = nBatchSize / nWorkers + (rank < nBatchSize % nWorkers);
+            std::mt19937 rgSample((unsigned)rank + 1);
+
+            Tanh<float> act;
+            SoftMaxLoss<float> loss;
+            MiniBatchStep<float, Tanh> sgd(fc1, fc2);
+            matrix::Matrix<float> batchImgs(dataset.nImgArea, nLocalBatch, false);
+            vector<size_t> labels(nLocalBatch);
+            matrix::Matrix<float> * grads[] = {&sgd.fc1WeightsGrads, &sgd.fc1BiasGrads,
+                                               &sgd.fc2WeightsGrads, &sgd.fc2BiasGrads};
+            vector<float> buffer(nReduce);
+
+            for (size_t iter = 0; iter < maxIter; ++iter) {
+                float fIterLossSum = 0.0f, fIterCorrected = 0.0f;
+                for (size_t step = 0; step < nSteps; ++step) {
+                    for (size_t iBatch = 0; iBatch < nLocalBatch; ++iBatch) {
+                        size_t iImg = nShardBegin + rgSample() % nShardSize;
+                        batchImgs.setCol(iBatch, dataset.x_train(iImg));
+                        labels[iBatch] = (size_t)dataset.y_train(iImg, 0);
+                    }
+                    sgd.Backward(batchImgs, labels);
+
+                    // all-reduce the gradients of the whole global batch
+                    float * p = buffer.data();
+                    for (auto g : grads) {
+                        p = std::copy(g->data(), g->data() + g->size, p);
+                    }
+                    buffer[nParams] = sgd.loss_ * nLocalBatch;
+                    buffer[nParams + 1] = std::round(sgd.precision_ * nLocalBatch);
+                    transport.AllReduce(buffer.data(), nReduce);
+                    p = buffer.data();
+                    for (auto g : grads) {
+                        std::copy(p, p + g->size, g->data());
+                        p += g->size;
+                    }
+                    fIterLossSum += buffer[nParams];
+                    fIterCorrected += buffer[nParams + 1];
+
+                    sgd.Update(lr, nBatchSize);
+                }
+                if (rank == 0) {
+                    cout << "[workers x" << nWorkers << "] iter " << iter << " loss = "
+                         << fIterLossSum / (nSteps * nBatchSize) << "\tprecision = "
+                         << fIterCorrected / (nSteps * nBatchSize) << endl;
+                }
+            }
+
+            if (rank == 0) {
+                uint32_t nTestCorrected = 0;
+                for (uint32_t i = 0; i < dataset.testImgs.size(); i++) {
+                    float fLoss;
+                    fc1.Forward(dataset.x_test(i).t());
+                    matrix::Matrix<float> outputs_ = act.Forward(fc1.outputs_); //a_fc1
+                    fc2.Forward(outputs_);
+                    auto label = (size_t)dataset.testLabel[i];
+                    nTestCorrected += (loss.Forward(fc2.outputs_, label, fLoss) == label);
+                }
+                cout << "[workers x" << nWorkers << "] accuracy = " << (float)nTestCorrected / dataset.testImgs.size() << endl;
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        size_t nFailed = LaunchWorkers(nWorkers, transport, worker);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (nWorkers == 1) {
+            baseSeconds = seconds;
+        }
+        cout << "[workers x" << nWorkers << "] " << seconds << "s\tspeedup = " << baseSeconds / seconds
+             << "x\tefficiency = " << baseSeconds / (seconds * nWorkers)
+             << (nFailed ? "\t(some workers failed)" : "") << endl;
+    }
+}
+
+void test_async_eval() {
+    auto start = std::chrono::steady_clock::now();
+    Dataset dataset = LoadDataset();
+
+    size_t fc1In = 28;
+    size_t fc2In = 10;
+    size_t maxIter = 20;
+    float lr = 0.05;
+    size_t nBatchSize = 64;
+    size_t nEvalEvery = 8;
+    size_t nPatience = 5;
+
+    std::random_device rd;
+    std::mt19937 rg(rd());
+    std::normal_distribution<float> normDist(0, 0.1);
+    auto genNormRand = [&]() { return normDist(rg); };
+    DenseLayer<float> fc1(dataset.nImgArea, fc1In, genNormRand), fc2(fc1In, fc2In, genNormRand);
+    Evaluator<float, Tanh> evaluator(dataset.x_test, dataset.testLabel, dataset.nImgArea, fc1In, fc2In, nPatience);
+    MiniBatchStep<float, Tanh> sgd(fc1, fc2);
+
+    matrix::Matrix<float> batchImgs(dataset.nImgArea, nBatchSize, false);
+    vector<size_t> labels(nBatchSize);
+    size_t iter, step = 0;
+    for (iter = 0; iter < maxIter && !evaluator.ShouldStop(); ++iter) {
+        for (size_t iImgdx = 0; iImgdx < dataset.x_train.nrow && !evaluator.ShouldStop(); iImgdx += nBatchSize) {
+            RandomBatch(dataset.x_train, dataset.y_train, batchImgs, labels);
+            sgd.Train(batchImgs, labels, lr);
+
+            // hand a snapshot to the evaluation thread and keep training
+            if (++step % nEvalEvery == 0) {
+                evaluator.Publish(step, fc1, fc2);
+            }
+        }
+    }
+    // the last step, unless it was just published
+    if (step % nEvalEvery != 0) {
+        evaluator.Publish(step, fc1, fc2);
+    }
+    evaluator.Stop();
+
+    auto history = evaluator.History();
+    auto best = history.front();
+    for (auto & record : history) {
+        if (record.loss < best.loss) {
+            best = record;
+        }
+    }
+    std::cout << "[test] best at step " << best.step << " loss = " << best.loss << " accuracy = "
+              << best.accuracy << std::endl;
+
+    std::cout << "Duration: " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+              << "s " << "for " << iter << " times durations, " << history.size() << " evaluations" << std::endl;
+}
+
+void test_gemm_autotune() {
+    std::mt19937 rg(2018);
+    std::normal_distribution<float> normDist(0, 0.1);
+    auto genNormRand = [&]() { return normDist(rg); };
+    gemm::Autotuner & tuner = gemm::Autotuner::Instance();
+    cout << "cpu: " << tuner.cpu_model << "\tcache: " << tuner.cache_path << endl;
+
+    // the products of test_dnn (batch 1 and 64) and their transposed backward forms
+    struct Shape { size_t M, N, K; bool transA, transB; };
+    vector<Shape> shapes = {{28, 1, 784, false, false}, {28, 64, 784, false, false},
+                            {10, 64, 28, false, false}, {28, 64, 10, true, false},
+                            {28, 784, 64, false, true}, {10, 28, 64, false, true}};
+    for (auto & shape : shapes) {
+        matrix::Matrix<float> A(shape.transA ? shape.K : shape.M, shape.transA ? shape.M : shape.K, genNormRand);
+        matrix::Matrix<float> B(shape.transB ? shape.N : shape.K, shape.transB ? shape.K : shape.N, genNormRand);
+        // naive triple loop, independent of the tuner and its kernel
+        matrix::Matrix<float> reference(shape.M, shape.N);
+        for (size_t i = 0; i < shape.M; ++i) {
+            for (size_t j = 0; j < shape.N; ++j) {
+                for (size_t k = 0; k < shape.K; ++k) {
+                    reference(i, j) += (shape.transA ? A(k, i) : A(i, k)) * (shape.transB ? B(j, k) : B(k, j));
+                }
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        matrix::Matrix<float> C = A.dot(B, shape.transA, shape.transB); // tunes on first sight
+        double tuneSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t nReps = 200;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < nReps; ++i) {
+            C = A.dot(B, shape.transA, shape.transB);
+        }
+        double tunedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / nReps;
+
+        matrix::Matrix<float> D(shape.M, shape.N, false);
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < nReps; ++i) {
+            gemm::Kernel<float>(shape.M, shape.N, shape.K, A.data(), shape.transA, B.data(), shape.transB,
+                                D.data()).Run(gemm::DefaultConfig());
+        }
+        double defaultSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / nReps;
+
+        float maxError = 0;
+        for (size_t i = 0; i < C.size; ++i) {
+            maxError = std::max(maxError, std::abs(C.data()[i] - reference.data()[i]));
+        }
+        gemm::Config config = gemm::DefaultConfig();
+        tuner.Lookup<float>(shape.M, shape.N, shape.K, shape.transA, shape.transB, config);
+        cout << shape.M << "x" << shape.N << "x" << shape.K << (shape.transA ? " A^T" : "") << (shape.transB ? " B^T" : "")
+             << "\tmc = " << config.mc << " nc = " << config.nc << " kc = " << config.kc << " order = " << (config.order == gemm::IJK ? "ijk" : "ikj")
+             << " threads = " << config.threads << "\ttuned " << tunedSeconds * 1e6 << "us vs default "
+             << defaultSeconds * 1e6 << "us (first call " << tuneSeconds * 1e3 << "ms)\tmax error = " << maxError << endl;
+    }
+}
+
+void test_reduction() {
+    std::mt19937 rg(2018);
+    std::normal_distribution<float> normDist(1, 0.1);
+    auto genNormRand = [&]() { return normDist(rg); };
+    matrix::Matrix<float> matrix1(1000, 10000, genNormRand);
+    const float * data = matrix1.data();
+
+    double reference = 0;
+    for (size_t i = 0; i < matrix1.size; ++i) {
+        reference += data[i];
+    }
+    for (auto acc : {reduction::Naive, reduction::Pairwise, reduction::Kahan}) {
+        clock_t start = clock();
+        float sum = matrix1.sum(acc);
+        cout << "sum[" << acc << "] = " << sum << "\terror = " << std::abs(sum - reference)
+             << "\t" << (clock() - start) / (double)CLOCKS_PER_SEC << "s" << endl;
+    }
+    clock_t start = clock();
+    float scalarSum = 0;
+    for (size_t i = 0; i < matrix1.size; ++i) {
+        scalarSum += data[i];
+    }
+    cout << "scalar sum = " << scalarSum << "\terror = " << std::abs(scalarSum - reference)
+         << "\t" << (clock() - start) / (double)CLOCKS_PER_SEC << "s" << endl;
+
+    start = clock();
+    float maxElement = matrix1.max_element();
+    auto maxIndex = matrix1.max_index();
+    cout << "max = " << maxElement << " at (" << maxIndex.first << ", " << maxIndex.second << ") min = "
+         << matrix1.min_element() << " norm = " << matrix1.norm() << "\t"
+         << (clock() - start) / (double)CLOCKS_PER_SEC << "s" << endl;
+    assert(matrix1(maxIndex.first, maxIndex.second) == *std::max_element(data, data + matrix1.size));
+
+    // axis reductions against a scalar reference, on shapes that cut rows and columns into several tiles
+    std::uniform_int_distribution<int> intDist(-50, 50);
+    auto genInt = [&]() { return (float)intDist(rg); }; // small integers, so ties are common
+    std::vector<matrix::Matrix<float> > shapes;
+    shapes.push_back(matrix1);
+    shapes.emplace_back(3, 100000, genInt);
+    shapes.emplace_back(100000, 3, genInt);
+    size_t nThreads = reduction::Threads();
+    for (const auto & m : shapes) {
+        for (int axis = 0; axis < 2; ++axis) {
+            reduction::Threads() = 4;
+            start = clock();
+            size_t nOut = axis == 0 ? m.ncol : m.nrow, nIn = axis == 0 ? m.nrow : m.ncol;
+            vector<size_t> maxIndex, minIndex;
+            matrix::Matrix<float> sums = m.sum(axis), norms = m.norm(axis);
+            matrix::Matrix<float> maxs = m.max(axis, &maxIndex), mins = m.min(axis, &minIndex);
+            double seconds = (clock() - start) / (double)CLOCKS_PER_SEC;
+            assert(maxIndex == m.argmax(axis) && minIndex == m.argmin(axis));
+            double maxError = 0;
+            for (size_t o = 0; o < nOut; ++o) {
+                double sum = 0, squares = 0, absSum = 0;
+                size_t iMax = 0, iMin = 0;
+                for (size_t k = 0; k < nIn; ++k) {
+                    float v = axis == 0 ? m(k, o) : m(o, k);
+                    sum += v;
+                    absSum += std::abs(v);
+                    squares += (double)v * v;
+                    float best = axis == 0 ? m(iMax, o) : m(o, iMax), worst = axis == 0 ? m(iMin, o) : m(o, iMin);
+                    iMax = v > best ? k : iMax;
+                    iMin = v < worst ? k : iMin;
+                }
+                maxError = std::max(maxError, std::abs(sums.data()[o] - sum) / std::max(absSum, 1.0));
+                maxError = std::max(maxError, std::abs(norms.data()[o] - std::sqrt(squares)) / std::max(std::sqrt(squares), 1.0));
+                assert(maxIndex[o] == iMax && minIndex[o] == iMin);
+                assert(maxs.data()[o] == (axis == 0 ? m(iMax, o) : m(o, iMax)));
+                assert(mins.data()[o] == (axis == 0 ? m(iMin, o) : m(o, iMin)));
+            }
+            assert(maxError < 1e-5);
+
+            // the tiling depends only on the shape, so one thread gives the same bits
+            reduction::Threads() = 1;
+            matrix::Matrix<float> serialSums = m.sum(axis), serialNorms = m.norm(axis);
+            for (size_t o = 0; o < nOut; ++o) {
+                assert(serialSums.data()[o] == sums.data()[o] && serialNorms.data()[o] == norms.data()[o]);
+            }
+            cout << m.nrow << "x" << m.ncol << " axis " << axis << ": sum/norm/max/min/argmax/argmin ok, max relative error = "
+                 << maxError << "\t" << seconds << "s" << endl;
+        }
+    }
+    reduction::Threads() = nThreads;
+
+    matrix::Matrix<float> grads = matrix1 * 0.01f;
+    float norm = ClipGradNorm(grads, 1.0f);
+    cout << "clip: norm " << norm << " -> " << grads.norm() << endl;
+
+    // batched accuracy: one forward pass over all test images and one argmax per column
+    Dataset dataset = LoadDataset();
+
+    std::normal_distribution<float> weightDist(0, 0.1);
+    auto genWeight = [&]() { return weightDist(rg); };
+    DenseLayer<float> fc1(dataset.nImgCols * dataset.nImgRows, 28, genWeight), fc2(28, 10, genWeight);
+    Tanh<float> act;
+    fc1.Forward(dataset.x_train.t());
+    fc2.Forward(act.Forward(fc1.outputs_));
+    vector<size_t> preds = fc2.outputs_.argmax(0);
+    size_t nCorrected = 0;
+    for (size_t i = 0; i < preds.size(); ++i) {
+        nCorrected += (preds[i] == (size_t)dataset.y_train(i, 0));
+    }
+    cout << "untrained batched precision = " << nCorrected / (float)preds.size() << endl;
+}
+
+void test_philox() {
+    // the same (seed, stream) gives the same numbers whatever the thread count
+    size_t n = 1000000;
+    vector<float> single(n), multi(n);
+    clock_t start = clock();
+    rng::FillNormal(single.data(), n, 0.0f, 0.1f, 2018, 0, 1);
+    cout << "philox normal x1: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s" << endl;
+    rng::FillNormal(multi.data(), n, 0.0f, 0.1f, 2018, 0, 4);
+    cout << "identical with 4 threads: " << (single == multi ? "yes" : "no") << endl;
+
+    std::mt19937 rg(2018);
+    std::normal_distribution<float> normDist(0, 0.1);
+    start = clock();
+    for (auto & x : multi) {
+        x = normDist(rg);
+    }
+    cout << "mt19937 normal: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s" << endl;
+
+    matrix::Matrix<float> normals(single);
+    float mean = normals.sum() / n;
+    cout << "mean = " << mean << " stddev = " << std::sqrt(normals.norm() * normals.norm() / n - mean * mean) << endl;
+}
+
+void test_dropout() {
+    clock_t start = clock();
+    Dataset dataset = LoadDataset();
+
+    size_t fc1In = 28;
+    size_t fc2In = 10;
+    size_t maxIter = 4;
+    float lr = 0.05;
+    size_t nBatchSize = 64;
+    float fDropRate = 0.1;
+    size_t nMaxShift = 2;
+    uint64_t seed = 2018;
+
+    // every tensor draws from its own Philox stream of one seed; dropout, the sampler and the
+    // augmentation each get a key of their own, since their streams start at 0 too
+    DenseLayer<float> fc1(dataset.nImgArea, fc1In), fc2(fc1In, fc2In);
+    fc1.weights_ = rng::Normal<float>(fc1In, dataset.nImgArea, 0, 0.1, seed, 0);
+    fc1.bias_ = rng::Normal<float>(fc1In, 1, 0, 0.1, seed, 1);
+    fc2.weights_ = rng::Normal<float>(fc2In, fc1In, 0, 0.1, seed, 2);
+    fc2.bias_ = rng::Normal<float>(fc2In, 1, 0, 0.1, seed, 3);
+    DropoutLayer<float> dropout(fDropRate, seed + 1);
+    Tanh<float> act;
+    SoftMaxLoss<float> loss;
+    MiniBatchStep<float, Tanh> sgd(fc1, fc2, &dropout);
+
+    rng::Philox sampler(seed + 2);
+    vector<uint32_t> draws(nBatchSize);
+    matrix::Matrix<float> batchImgs(dataset.nImgArea, nBatchSize, false);
+    vector<size_t> labels(nBatchSize);
+    size_t iter;
+    for (iter = 0; iter < maxIter; ++iter) {
+        for (size_t iImgdx = 0; iImgdx < dataset.x_train.nrow; iImgdx += nBatchSize) {
+            sampler.Fill(iter, iImgdx, draws.data(), nBatchSize);
+            for (size_t iBatch = 0; iBatch < nBatchSize; ++iBatch) {
+                size_t iImg = draws[iBatch] % dataset.trainImgs.size();
+                batchImgs.setCol(iBatch, Augment(dataset.x_train(iImg), dataset.nImgRows, dataset.nImgCols, nMaxShift,
+                                                 0.0f, seed + 3, iter, iImgdx + iBatch));
+                labels[iBatch] = (size_t)dataset.y_train(iImg, 0);
+            }
+            sgd.Train(batchImgs, labels, lr);
+            cout << "loss = " << sgd.loss_ << "\tprecision = " << sgd.precision_ << endl;
+        }
+    }
+
+    float fLossSum = 0.0f, fLoss;
+    uint32_t nCorrected = 0;
+    for (uint32_t i = 0; i < dataset.testImgs.size(); i++) {
+        fc1.Forward(dataset.x_test(i).t());
+        dropout.Forward(act.Forward(fc1.outputs_), false);
+        fc2.Forward(dropout.outputs_);
+        auto label = (size_t)dataset.testLabel[i];
         size_t nPred = loss.Forward(fc2.outputs_, label, fLoss);
 
         fLossSum += fLoss;
         nCorrected += (nPred == label);
     }
-    std::cout << "[test] " << "loss = " << fLossSum / testImgs.size() << " accuracy = "
-              << (float)nCorrected / testImgs.size() << std::endl;
+    std::cout << "[test] " << "loss = " << fLossSum / dataset.testImgs.size() << " accuracy = "
+              << (float)nCorrected / dataset.testImgs.size() << std::endl;
 
     std::cout << "Duration: " << (clock() - start) / (double)CLOCKS_PER_SEC << "s " << "for " << iter
               << " times durations" << std::endl;
 }
 
+void test_sweep() {
+    Dataset dataset = LoadDataset();
+
+    size_t fc2In = 10;
+    size_t nBatchSize = 64;
+    size_t nSteps = 4 * dataset.x_train.nrow / nBatchSize;
+    vector<SweepConfig<float> > configs = {{0.05, 28, TANH}, {0.1, 28, TANH}, {0.2, 28, TANH},
+                                           {0.05, 64, TANH}, {0.1, 64, RELU}, {0.5, 28, SIGMOID}};
+
+    // one process per variant, as before: every run gathers its own batches
+    auto start = std::chrono::steady_clock::now();
+    for (auto & config : configs) {
+        SweepRunner<float> single({config}, dataset.nImgArea, fc2In, 2018);
+        single.Train(dataset.x_train, dataset.y_train, nSteps, nBatchSize, 2018);
+    }
+    double sequentialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // all variants at once, sharing the data, the batches and the first-layer GEMMs
+    start = std::chrono::steady_clock::now();
+    SweepRunner<float> sweep(configs, dataset.nImgArea, fc2In, 2018);
+    sweep.Train(dataset.x_train, dataset.y_train, nSteps, nBatchSize, 2018);
+    double sweepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const char * activations[] = {"sigmoid", "tanh", "relu"};
+    vector<float> accuracy = sweep.Evaluate(dataset.x_test, dataset.testLabel);
+    for (size_t m = 0; m < sweep.size(); ++m) {
+        cout << "lr = " << sweep.config(m).learning_rate << "\tfc1In = " << sweep.config(m).hidden << "\t"
+             << activations[sweep.config(m).activation] << "\tloss = " << sweep.loss(m) << "\tprecision = "
+             << sweep.precision(m) << "\taccuracy = " << accuracy[m] << endl;
+    }
+    cout << configs.size() << " models: sequential " << sequentialSeconds << "s, concurrent " << sweepSeconds
+         << "s (" << sequentialSeconds / sweepSeconds << "x)" << endl;
+}
+
+void test_serving() {
+    Dataset dataset = LoadDataset();
+
+    // the test_dnn network, trained in-process for a few epochs
+    size_t fc1In = 28;
+    size_t fc2In = 10;
+    std::mt19937 rg(2018);
+    std::normal_distribution<float> normDist(0, 0.1);
+    auto genNormRand = [&]() { return normDist(rg); };
+    DenseLayer<float> fc1(dataset.nImgArea, fc1In, genNormRand), fc2(fc1In, fc2In, genNormRand);
+    Hogwild<float, Tanh> hogwild(fc1, fc2, 1);
+    for (size_t iter = 0; iter < 4; ++iter) {
+        hogwild.Train(dataset.x_train, dataset.y_train, dataset.x_train.nrow, 0.01, (unsigned)(iter * 1000));
+    }
+
+    // the test images as clients send them: base-41 like the data file, and raw floats
+    vector<string> b41Lines, rawLines;
+    for (auto & img : dataset.testImgs) {
+        b41Lines.push_back("B41 " + EncodeImage(img));
+        std::ostringstream raw;
+        raw << "RAW";
+        for (float f : img) {
+            raw << ' ' << f;
+        }
+        rawLines.push_back(raw.str());
+    }
+
+    string endpoint = "/tmp/deep_learning_serving.sock";
+    for (size_t budget : {0, 1000}) {
+        PredictionServer<float, Tanh> server(fc1, fc2, endpoint, 64, budget);
+        server.Start();
+
+        // the served classes must be those of the offline model
+        Tanh<float> act;
+        int fd = serving::Connect(endpoint);
+        serving::LineReader reader(fd);
+        string answer;
+        uint32_t nCorrected = 0, nMismatched = 0;
+        for (uint32_t i = 0; i < dataset.testImgs.size(); ++i) {
+            serving::WriteAll(fd, b41Lines[i] + "\n");
+            reader.ReadLine(answer);
+            size_t nPred = std::stoul(answer);
+            fc1.Forward(matrix::Matrix<float>(dataset.testImgs[i]).t());
+            fc2.Forward(act.Forward(fc1.outputs_));
+            nMismatched += (nPred != fc2.outputs_.max_index().first);
+            nCorrected += (nPred == (size_t)dataset.testLabel[i]);
+        }
+        close(fd);
+        cout << "latency budget " << budget << "us, served accuracy = " << (float)nCorrected / dataset.testImgs.size()
+             << ", " << nMismatched << " answers differ from the offline model" << endl;
+
+        for (size_t nClients : {1, 4, 16, 64}) {
+            serving::LoadGenerator b41(endpoint, b41Lines), raw(endpoint, rawLines);
+            cout << "  " << nClients << " clients, B41: " << b41.Run(nClients, 2000 / nClients).ToString() << endl;
+            cout << "  " << nClients << " clients, RAW: " << raw.Run(nClients, 2000 / nClients).ToString() << endl;
+        }
+        cout << "  server: " << server.Stats() << endl;
+        server.Stop();
+    }
+}
+
+// Serves the test_dnn network until Enter is pressed, printing the counters every second.
+// Try it with: echo STATS | nc -U /tmp/deep_learning_serving.sock
+void test_prediction_daemon() {
+    Dataset dataset = LoadDataset();
+
+    std::mt19937 rg(2018);
+    std::normal_distribution<float> normDist(0, 0.1);
+    auto genNormRand = [&]() { return normDist(rg); };
+    DenseLayer<float> fc1(dataset.nImgArea, 28, genNormRand), fc2(28, 10, genNormRand);
+    Hogwild<float, Tanh> hogwild(fc1, fc2, 1);
+    for (size_t iter = 0; iter < 4; ++iter) {
+        hogwild.Train(dataset.x_train, dataset.y_train, dataset.x_train.nrow, 0.01, (unsigned)(iter * 1000));
+    }
+
+    PredictionServer<float, Tanh> server(fc1, fc2, "/tmp/deep_learning_serving.sock", 64, 2000);
+    server.Start();
+    server.Report(1000);
+    cout << "serving on " << server.endpoint << ", press Enter to stop" << endl;
+    cin.get();
+    server.Stop();
+}
+
 void test_speed_matrix() {
     std::random_device rd;
     std::mt19937 rg(rd());
@@ -300,6 +1100,18 @@ int main() {
     //test_softmax();
     //test_load_data();
     test_dnn();
+    //test_fixed_dnn();
+    //test_cnn();
+    //test_hogwild();
+    //test_data_parallel();
+    //test_async_eval();
+    //test_gemm_autotune();
+    //test_reduction();
+    //test_philox();
+    //test_dropout();
+    //test_sweep();
+    //test_serving();
+    //test_prediction_daemon();
     //test_speed_matrix();
     //test_eigen();
     return 0;
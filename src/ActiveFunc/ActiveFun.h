@@ -13,6 +13,7 @@ static const float MAX_EXP = 50;
 template <typename T>
 class ActiveFun {
 public:
+    virtual ~ActiveFun() = default;
     virtual matrix::Matrix<T> Forward(const matrix::Matrix<T> & inputs_) = 0;
     virtual matrix::Matrix<T> grad_() = 0;
 };
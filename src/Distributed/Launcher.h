@@ -0,0 +1,88 @@
+#ifndef DEEP_LEARNING_LAUNCHER_H
+#define DEEP_LEARNING_LAUNCHER_H
+
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "Transport.h"
+
+// Forks n_workers processes that each run fn(rank), then waits for all of them. As soon
+// as one worker fails the others are killed, since they would wait for it forever in
+// their next collective. Returns the number of workers that did not exit cleanly.
+template <typename __Fn, typename __OnFailure>
+size_t __LaunchWorkers(size_t n_workers, __Fn fn, __OnFailure on_failure) {
+    // buffered output would otherwise be printed once per worker
+    std::cout.flush();
+    fflush(stdout);
+
+    std::vector<pid_t> pids;
+    for (size_t rank = 0; rank < n_workers; ++rank) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            // the workers already started would wait forever for the missing one
+            for (pid_t started : pids) {
+                kill(started, SIGKILL);
+                waitpid(started, nullptr, 0);
+            }
+            throw std::runtime_error("LaunchWorkers: fork failed");
+        }
+        if (pid == 0) {
+            int status = 0;
+            try {
+                fn(rank);
+            } catch (const std::exception & e) {
+                std::cerr << "worker " << rank << ": " << e.what() << std::endl;
+                on_failure();
+                status = 1;
+            }
+            std::cout.flush();
+            fflush(stdout);
+            _exit(status);
+        }
+        pids.push_back(pid);
+    }
+
+    size_t nFailed = 0;
+    while (!pids.empty()) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            nFailed += pids.size();
+            break;
+        }
+        auto it = std::find(pids.begin(), pids.end(), pid);
+        if (it == pids.end()) {
+            continue;
+        }
+        pids.erase(it);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ++nFailed;
+            for (pid_t other : pids) {
+                kill(other, SIGKILL);
+            }
+        }
+    }
+    return nFailed;
+}
+
+template <typename __Fn>
+size_t LaunchWorkers(size_t n_workers, __Fn fn) {
+    return __LaunchWorkers(n_workers, fn, []() {});
+}
+
+// a worker that throws aborts the transport, so the others leave their collectives at once
+template <typename __Fn, typename T>
+size_t LaunchWorkers(size_t n_workers, Transport<T> & transport, __Fn fn) {
+    return __LaunchWorkers(n_workers, fn, [&transport]() { transport.Abort(); });
+}
+
+#endif //DEEP_LEARNING_LAUNCHER_H
@@ -0,0 +1,138 @@
+#ifndef DEEP_LEARNING_SHMTRANSPORT_H
+#define DEEP_LEARNING_SHMTRANSPORT_H
+
+#include <new>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "Transport.h"
+
+// Ring all-reduce over a shared mapping created before fork; each worker calls Attach(rank).
+template <typename T>
+class ShmTransport : public Transport<T> {
+public:
+    ShmTransport(size_t n_workers, size_t max_count)
+            : n_workers(n_workers), max_count(max_count), __rank(0), __sense(false), __owner(getpid()) {
+        assert(n_workers > 0);
+        __bytes = sizeof(__Header) + n_workers * max_count * sizeof(T);
+        void * p = mmap(nullptr, __bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("ShmTransport: mmap failed");
+        }
+        __header = new(p) __Header();
+        __slots = reinterpret_cast<T *>(static_cast<char *>(p) + sizeof(__Header));
+    }
+
+    ~ShmTransport() {
+        // forked workers leave the mapping to the process that created it
+        if (getpid() == __owner) {
+            __header->~__Header();
+            munmap(__header, __bytes);
+        }
+    }
+
+    ShmTransport(const ShmTransport &) = delete;
+    ShmTransport & operator=(const ShmTransport &) = delete;
+
+    void Attach(size_t rank) {
+        assert(rank < n_workers);
+        __rank = rank;
+    }
+
+    size_t Rank() const {
+        return __rank;
+    }
+
+    size_t Size() const {
+        return n_workers;
+    }
+
+    // sense-reversing spin barrier on atomics inside the shared mapping
+    void Barrier() {
+        CheckAborted();
+        __sense = !__sense;
+        if (__header->count.fetch_add(1) + 1 == n_workers) {
+            __header->count.store(0);
+            __header->sense.store(__sense);
+        } else {
+            while (__header->sense.load() != __sense) {
+                CheckAborted();
+                sched_yield();
+            }
+        }
+    }
+
+    void Abort() {
+        __header->aborted.store(true);
+    }
+
+    void AllReduce(T * data, size_t count) {
+        assert(count <= max_count);
+        if (n_workers == 1) {
+            return;
+        }
+        T * mine = slot(__rank);
+        const T * left = slot((__rank + n_workers - 1) % n_workers);
+        std::memcpy(mine, data, count * sizeof(T));
+        Barrier();
+
+        // reduce-scatter: at step s, add the left neighbour's chunk r - 1 - s into ours
+        for (size_t s = 0; s + 1 < n_workers; ++s) {
+            size_t c = (__rank + 2 * n_workers - 1 - s) % n_workers;
+            size_t begin = chunk_begin(c, count), end = chunk_begin(c + 1, count);
+            for (size_t i = begin; i < end; ++i) {
+                mine[i] += left[i];
+            }
+            Barrier();
+        }
+
+        // all-gather: at step s, copy the left neighbour's reduced chunk r - s
+        for (size_t s = 0; s + 1 < n_workers; ++s) {
+            size_t c = (__rank + n_workers - s) % n_workers;
+            size_t begin = chunk_begin(c, count), end = chunk_begin(c + 1, count);
+            std::memcpy(mine + begin, left + begin, (end - begin) * sizeof(T));
+            Barrier();
+        }
+
+        std::memcpy(data, mine, count * sizeof(T));
+    }
+
+    size_t n_workers;
+    size_t max_count;
+
+private:
+    struct __Header {
+        std::atomic<size_t> count;
+        std::atomic<bool> sense;
+        std::atomic<bool> aborted;
+
+        __Header() : count(0), sense(false), aborted(false) {}
+    };
+
+    void CheckAborted() const {
+        if (__header->aborted.load()) {
+            throw std::runtime_error("ShmTransport: another worker aborted");
+        }
+    }
+
+    inline T * slot(size_t rank) {
+        return __slots + rank * max_count;
+    }
+
+    inline size_t chunk_begin(size_t c, size_t count) const {
+        return c * count / n_workers;
+    }
+
+    size_t __rank;
+    bool __sense;
+    pid_t __owner;
+    size_t __bytes;
+    __Header * __header;
+    T * __slots;
+};
+
+#endif //DEEP_LEARNING_SHMTRANSPORT_H
@@ -0,0 +1,27 @@
+#ifndef DEEP_LEARNING_TRANSPORT_H
+#define DEEP_LEARNING_TRANSPORT_H
+
+#include <cstddef>
+
+// Collective communication between the workers of a data-parallel job.
+// ShmTransport implements it over shared memory between processes on one machine;
+// a network transport only has to provide the same four operations.
+template <typename T>
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    virtual size_t Rank() const = 0;
+    virtual size_t Size() const = 0;
+
+    // blocks until every worker has reached it
+    virtual void Barrier() = 0;
+
+    // replaces data[0, count) on every worker with the element-wise sum over all workers
+    virtual void AllReduce(T * data, size_t count) = 0;
+
+    // called by a failing worker: every worker waiting in, or later entering, a collective throws
+    virtual void Abort() = 0;
+};
+
+#endif //DEEP_LEARNING_TRANSPORT_H
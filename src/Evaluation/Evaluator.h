@@ -0,0 +1,161 @@
+#ifndef DEEP_LEARNING_EVALUATOR_H
+#define DEEP_LEARNING_EVALUATOR_H
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <limits>
+#include <sstream>
+#include <utility>
+#include <iostream>
+#include <condition_variable>
+#include "../Matrix.h"
+#include "../Loss/Loss.h"
+#include "../Layer/DenseLayer.h"
+
+// Scores published weight snapshots of the test_dnn network on a background thread;
+// ShouldStop() turns true after patience evaluations without a min_delta improvement.
+template <typename T, template <typename> class __Act>
+class Evaluator {
+public:
+    struct Record {
+        size_t step;
+        T loss;
+        T accuracy;
+    };
+
+    Evaluator(const matrix::Matrix<T> & x_test,
+              const std::vector<T> & y_test,
+              size_t last_n_neurons,
+              size_t hidden_neurons,
+              size_t n_neurons,
+              size_t patience,
+              T min_delta=0)
+            : x_test(x_test),
+              y_test(y_test),
+              patience(patience),
+              min_delta(min_delta),
+              __front(last_n_neurons, hidden_neurons, n_neurons),
+              __back(last_n_neurons, hidden_neurons, n_neurons),
+              __pending(false),
+              __stopping(false),
+              __should_stop(false),
+              __best_loss(std::numeric_limits<T>::max()),
+              __n_bad(0) {
+        __worker = std::thread(&Evaluator::Loop, this);
+    }
+
+    ~Evaluator() {
+        Stop();
+    }
+
+    Evaluator(const Evaluator &) = delete;
+    Evaluator & operator=(const Evaluator &) = delete;
+
+    void Publish(size_t step, const DenseLayer<T> & fc1, const DenseLayer<T> & fc2) {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            __back.step = step;
+            __back.fc1.weights_ = fc1.weights_;
+            __back.fc1.bias_ = fc1.bias_;
+            __back.fc2.weights_ = fc2.weights_;
+            __back.fc2.bias_ = fc2.bias_;
+            __pending = true;
+        }
+        __cond.notify_one();
+    }
+
+    bool ShouldStop() const {
+        return __should_stop.load();
+    }
+
+    // scores the last published snapshot if it is still pending, then joins the thread
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            __stopping = true;
+        }
+        __cond.notify_one();
+        if (__worker.joinable()) {
+            __worker.join();
+        }
+    }
+
+    std::vector<Record> History() const {
+        std::lock_guard<std::mutex> lock(__mutex);
+        return __history;
+    }
+
+    const matrix::Matrix<T> & x_test;
+    const std::vector<T> & y_test;
+    size_t patience;
+    T min_delta;
+
+private:
+    struct __Snapshot {
+        __Snapshot(size_t last_n_neurons, size_t hidden_neurons, size_t n_neurons)
+                : step(0), fc1(last_n_neurons, hidden_neurons), fc2(hidden_neurons, n_neurons) {}
+
+        size_t step;
+        DenseLayer<T> fc1;
+        DenseLayer<T> fc2;
+    };
+
+    void Loop() {
+        __Act<T> act;
+        SoftMaxLoss<T> loss;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(__mutex);
+                __cond.wait(lock, [this]() { return __pending || __stopping; });
+                if (!__pending) {
+                    return;
+                }
+                std::swap(__front, __back);
+                __pending = false;
+            }
+
+            T fLossSum = 0, fLoss;
+            size_t nCorrected = 0;
+            for (size_t i = 0; i < x_test.nrow; ++i) {
+                __front.fc1.Forward(x_test(i).t());
+                matrix::Matrix<T> outputs_ = act.Forward(__front.fc1.outputs_); //a_fc1
+                __front.fc2.Forward(outputs_);
+                auto label = (size_t)y_test[i];
+                nCorrected += (loss.Forward(__front.fc2.outputs_, label, fLoss) == label);
+                fLossSum += fLoss;
+            }
+            Record record = {__front.step, fLossSum / x_test.nrow, nCorrected / (T)x_test.nrow};
+
+            if (record.loss < __best_loss - min_delta) {
+                __best_loss = record.loss;
+                __n_bad = 0;
+            } else if (++__n_bad >= patience) {
+                __should_stop.store(true);
+            }
+
+            std::ostringstream line;
+            line << "[eval] step " << record.step << " loss = " << record.loss
+                 << " accuracy = " << record.accuracy << (__should_stop.load() ? " (early stop)" : "") << "\n";
+            std::cout << line.str() << std::flush;
+
+            std::lock_guard<std::mutex> lock(__mutex);
+            __history.push_back(record);
+        }
+    }
+
+    __Snapshot __front; // owned by the evaluation thread
+    __Snapshot __back; // written by Publish, guarded by __mutex
+    bool __pending;
+    bool __stopping;
+    std::atomic<bool> __should_stop;
+    T __best_loss;
+    size_t __n_bad;
+    std::vector<Record> __history;
+    mutable std::mutex __mutex;
+    std::condition_variable __cond;
+    std::thread __worker;
+};
+
+#endif //DEEP_LEARNING_EVALUATOR_H
@@ -0,0 +1,249 @@
+#ifndef DEEP_LEARNING_FIXEDMATRIX_H
+#define DEEP_LEARNING_FIXEDMATRIX_H
+
+#include <cassert>
+#include <cstdio>
+#include <utility>
+#include "Matrix.h"
+
+namespace matrix {
+    // Statically-sized counterpart of Matrix: shapes are template parameters, storage lives
+    // inline (on the stack or inside the owning object) and every loop has constant bounds,
+    // so the compiler can fully unroll / vectorize it. Shape mismatches between two
+    // FixedMatrix operands fail to compile instead of tripping an assert.
+    template <typename T, size_t R, size_t C>
+    class FixedMatrix {
+    public:
+        static constexpr size_t nrow = R;
+        static constexpr size_t ncol = C;
+        static constexpr size_t size = R * C;
+
+        explicit FixedMatrix(bool initialize=true) {
+            if (initialize) {
+                setZero();
+            }
+        }
+        template <typename __Generator>
+        explicit FixedMatrix(__Generator generator) {
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] = generator();
+            }
+        }
+        explicit FixedMatrix(const Matrix<T> & other) {
+            assert(other.nrow == R && other.ncol == C);
+            const T * src = other.data();
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] = src[i];
+            }
+        }
+
+        inline T operator()(size_t i, size_t j) const {
+            return __data[j + i * C];
+        }
+
+        inline T &operator()(size_t i, size_t j) {
+            return __data[j + i * C];
+        }
+
+        inline FixedMatrix<T, 1, C> operator()(size_t i) const {
+            FixedMatrix<T, 1, C> row(false);
+            for (size_t j = 0; j < C; ++j) {
+                row(0, j) = __data[i * C + j];
+            }
+            return row;
+        }
+
+        template <size_t K>
+        FixedMatrix<T, R, K> dot(const FixedMatrix<T, C, K> & other) const {
+            FixedMatrix<T, R, K> res;
+            // i-j-k order keeps the innermost loop contiguous in both res and other
+            for (size_t i = 0; i < R; ++i) {
+                for (size_t j = 0; j < C; ++j) {
+                    const T a = __data[j + i * C];
+                    for (size_t k = 0; k < K; ++k) {
+                        res(i, k) += a * other(j, k);
+                    }
+                }
+            }
+            return res;
+        }
+
+        // Mixed product with a dynamic right-hand side, e.g. a fixed layer fed by a Matrix.
+        Matrix<T> dot(const Matrix<T> & other) const {
+            assert(C == other.nrow);
+            Matrix<T> res(R, other.ncol);
+            for (size_t i = 0; i < R; ++i) {
+                for (size_t j = 0; j < C; ++j) {
+                    const T a = __data[j + i * C];
+                    for (size_t k = 0; k < other.ncol; ++k) {
+                        res(i, k) += a * other(j, k);
+                    }
+                }
+            }
+            return res;
+        }
+
+        FixedMatrix<T, R, C> operator*(const FixedMatrix<T, R, C> & other) const {
+            FixedMatrix<T, R, C> res(false);
+            for (size_t i = 0; i < size; ++i) {
+                res.__data[i] = __data[i] * other.__data[i];
+            }
+            return res;
+        }
+
+        FixedMatrix<T, R, C> operator+(const FixedMatrix<T, R, C> & other) const {
+            FixedMatrix<T, R, C> res(false);
+            for (size_t i = 0; i < size; ++i) {
+                res.__data[i] = __data[i] + other.__data[i];
+            }
+            return res;
+        }
+
+        FixedMatrix<T, R, C> operator-(const FixedMatrix<T, R, C> & other) const {
+            FixedMatrix<T, R, C> res(false);
+            for (size_t i = 0; i < size; ++i) {
+                res.__data[i] = __data[i] - other.__data[i];
+            }
+            return res;
+        }
+
+        FixedMatrix<T, R, C> operator-() const {
+            FixedMatrix<T, R, C> res(false);
+            for (size_t i = 0; i < size; ++i) {
+                res.__data[i] = -__data[i];
+            }
+            return res;
+        }
+
+        inline void operator+=(const FixedMatrix<T, R, C> & other) {
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] += other.__data[i];
+            }
+        }
+
+        inline void operator-=(const FixedMatrix<T, R, C> & other) {
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] -= other.__data[i];
+            }
+        }
+
+        inline void operator*=(const FixedMatrix<T, R, C> & other) {
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] *= other.__data[i];
+            }
+        }
+
+        inline FixedMatrix<T, R, C> operator*(T scalar) const {
+            FixedMatrix<T, R, C> res(false);
+            for (size_t i = 0; i < size; ++i) {
+                res.__data[i] = __data[i] * scalar;
+            }
+            return res;
+        }
+
+        inline FixedMatrix<T, R, C> operator/(T scalar) const {
+            assert(scalar != 0);
+            FixedMatrix<T, R, C> res(false);
+            for (size_t i = 0; i < size; ++i) {
+                res.__data[i] = __data[i] / scalar;
+            }
+            return res;
+        }
+
+        inline void operator*=(T scalar) {
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] *= scalar;
+            }
+        }
+
+        inline void operator/=(T scalar) {
+            assert(scalar != 0);
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] /= scalar;
+            }
+        }
+
+        FixedMatrix<T, C, R> transpose() const {
+            FixedMatrix<T, C, R> res(false);
+            for (size_t i = 0; i < R; ++i) {
+                for (size_t j = 0; j < C; ++j) {
+                    res(j, i) = __data[j + i * C];
+                }
+            }
+            return res;
+        }
+
+        inline FixedMatrix<T, C, R> t() const {
+            return transpose();
+        }
+
+        inline void setZero() {
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] = 0;
+            }
+        }
+
+        inline void setOnes() {
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] = 1;
+            }
+        }
+
+        T max_element() const {
+            static_assert(size != 0, "max_element of an empty FixedMatrix");
+            T max = __data[0];
+            for (size_t i = 1; i < size; ++i) {
+                if (__data[i] > max) {
+                    max = __data[i];
+                }
+            }
+            return max;
+        }
+
+        std::pair<size_t, size_t> max_index() const {
+            static_assert(size != 0, "max_index of an empty FixedMatrix");
+            T max = __data[0];
+            size_t max_index = 0;
+            for (size_t i = 1; i < size; ++i) {
+                if (__data[i] > max) {
+                    max = __data[i];
+                    max_index = i;
+                }
+            }
+            return std::make_pair(max_index / C, max_index % C);
+        }
+
+        Matrix<T> toMatrix() const {
+            Matrix<T> res(R, C, false);
+            T * dst = res.data();
+            for (size_t i = 0; i < size; ++i) {
+                dst[i] = __data[i];
+            }
+            return res;
+        }
+
+        inline T * data() {
+            return __data;
+        }
+
+        inline const T * data() const {
+            return __data;
+        }
+
+        void print() const {
+            toMatrix().print();
+        }
+
+    private:
+        alignas(32) T __data[R * C];
+    };
+
+    template <typename T, size_t R, size_t C>
+    constexpr size_t FixedMatrix<T, R, C>::nrow;
+    template <typename T, size_t R, size_t C>
+    constexpr size_t FixedMatrix<T, R, C>::ncol;
+    template <typename T, size_t R, size_t C>
+    constexpr size_t FixedMatrix<T, R, C>::size;
+}
+
+#endif //DEEP_LEARNING_FIXEDMATRIX_H
@@ -0,0 +1,374 @@
+#ifndef DEEP_LEARNING_AUTOTUNER_H
+#define DEEP_LEARNING_AUTOTUNER_H
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Gemm.h"
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+namespace gemm {
+    template <typename T>
+    struct DType {
+        static const int id = sizeof(T);
+
+        static std::string name() {
+            return "t" + std::to_string(sizeof(T));
+        }
+    };
+
+    template <>
+    struct DType<float> {
+        static const int id = -1;
+
+        static std::string name() {
+            return "f32";
+        }
+    };
+
+    template <>
+    struct DType<double> {
+        static const int id = -2;
+
+        static std::string name() {
+            return "f64";
+        }
+    };
+
+    // the key of a tuned config
+    struct Shape {
+        size_t M, N, K;
+        int dtype;
+        bool transA, transB;
+
+        bool operator==(const Shape & other) const {
+            return M == other.M && N == other.N && K == other.K && dtype == other.dtype &&
+                   transA == other.transA && transB == other.transB;
+        }
+    };
+
+    struct ShapeHash {
+        size_t operator()(const Shape & shape) const {
+            size_t h = std::hash<size_t>()(shape.M);
+            h = h * 31 + std::hash<size_t>()(shape.N);
+            h = h * 31 + std::hash<size_t>()(shape.K);
+            return h * 31 + (size_t)(shape.dtype * 4 + shape.transA * 2 + shape.transB);
+        }
+    };
+
+    // Picks the fastest Config for every (M, N, K, dtype, transA, transB) the first time
+    // the shape is multiplied, by timing each candidate on the real operands.
+    //
+    // Winners are appended to a text cache, one per line:
+    //     <cpu model>\t<M> <N> <K> <dtype> <transA> <transB>\t<mc> <nc> <kc> <order> <threads>
+    // and only the lines of the current CPU model are loaded at startup, so one cache
+    // file can be shared by several machines. The file is DEEP_LEARNING_GEMM_CACHE,
+    // default ~/.cache/deep_learning_gemm.cache; DEEP_LEARNING_GEMM_TUNE=0 turns tuning off.
+    class Autotuner {
+    public:
+        static Autotuner & Instance() {
+            static Autotuner instance;
+            return instance;
+        }
+
+        template <typename T>
+        void Dot(size_t M, size_t N, size_t K,
+                 const T * A, bool transA,
+                 const T * B, bool transB,
+                 T * C) {
+            Kernel<T> kernel(M, N, K, A, transA, B, transB, C);
+            // below this size the timer and the lookup cost more than any config saves
+            if (!enabled || M * N * K < min_work) {
+                kernel.Run(DefaultConfig());
+                return;
+            }
+            Config config;
+            if (!Select(kernel, M, N, K, transA, transB, config)) {
+                kernel.Run(config);
+            }
+        }
+
+        // C[i] = op(A[i]) * op(B[i]) for count products of one shape: the config is looked up
+        // once and the products, rather than the rows of each, are split over the threads
+        // by parallel_for(count, fn), which must call fn(i) for every i in [0, count).
+        template <typename T, typename __ParallelFor>
+        void BatchedDot(size_t count, size_t M, size_t N, size_t K,
+                        const T * const * A, bool transA,
+                        const T * const * B, bool transB,
+                        T * const * C,
+                        __ParallelFor parallel_for) {
+            if (count == 0) {
+                return;
+            }
+            Config config = DefaultConfig();
+            if (enabled && M * N * K >= min_work) {
+                Kernel<T> first(M, N, K, A[0], transA, B[0], transB, C[0]);
+                Select(first, M, N, K, transA, transB, config);
+            }
+            config.threads = 1;
+            parallel_for(count, [&](size_t i) {
+                Kernel<T>(M, N, K, A[i], transA, B[i], transB, C[i]).Run(config);
+            });
+        }
+
+        // the tuned config of a shape, or false if it has not been seen yet
+        template <typename T>
+        bool Lookup(size_t M, size_t N, size_t K, bool transA, bool transB, Config & config) const {
+            std::lock_guard<std::mutex> lock(__mutex);
+            Shape shape = {M, N, K, DType<T>::id, transA, transB};
+            auto it = __configs.find(shape);
+            if (it == __configs.end()) {
+                return false;
+            }
+            config = it->second;
+            return true;
+        }
+
+        std::string cpu_model;
+        std::string cache_path;
+        bool enabled;
+        size_t min_work;
+
+    private:
+        Autotuner() : enabled(true), min_work(4096), __owner(getpid()) {
+            cpu_model = CpuModel();
+            const char * path = std::getenv("DEEP_LEARNING_GEMM_CACHE");
+            cache_path = path ? path : DefaultCachePath();
+            const char * tune = std::getenv("DEEP_LEARNING_GEMM_TUNE");
+            if (tune && std::string(tune) == "0") {
+                enabled = false;
+            }
+            Load();
+        }
+
+        typedef std::unordered_map<Shape, Config, ShapeHash> __ConfigMap;
+
+        // The config of the kernel's shape, tuning it on first sight. Returns true when it
+        // was just tuned, in which case C already holds the product.
+        template <typename T>
+        bool Select(const Kernel<T> & kernel, size_t M, size_t N, size_t K, bool transA, bool transB,
+                    Config & config) {
+            Shape shape = {M, N, K, DType<T>::id, transA, transB};
+            // a config never changes once tuned, so each thread keeps the ones it has used
+            // and only takes the lock for a shape it has not seen yet
+            auto & local = LocalConfigs();
+            auto hit = local.find(shape);
+            if (hit != local.end()) {
+                config = hit->second;
+                return false;
+            }
+
+            bool found;
+            {
+                std::lock_guard<std::mutex> lock(__mutex);
+                auto it = __configs.find(shape);
+                found = it != __configs.end();
+                if (found) {
+                    config = it->second;
+                }
+            }
+            if (found) {
+                local[shape] = config;
+                return false;
+            }
+
+            // benchmark outside the lock; every candidate overwrites C with the same product
+            config = Tune(kernel, M, N, K);
+            {
+                std::lock_guard<std::mutex> lock(__mutex);
+                auto inserted = __configs.insert(std::make_pair(shape, config));
+                config = inserted.first->second;
+                // forked workers tune the same shapes; only the process that loaded the cache writes it
+                if (inserted.second && !cache_path.empty() && getpid() == __owner) {
+                    std::ofstream cache(cache_path, std::ios::app);
+                    cache << cpu_model << "\t" << Key<T>(shape) << "\t" << config.mc << " " << config.nc << " "
+                          << config.kc << " " << config.order << " " << config.threads << "\n";
+                }
+            }
+            local[shape] = config;
+            return true;
+        }
+
+        static __ConfigMap & LocalConfigs() {
+            thread_local __ConfigMap configs;
+            return configs;
+        }
+
+        // ~/.cache/deep_learning_gemm.cache, or no cache file at all without a home directory
+        static std::string DefaultCachePath() {
+            const char * home = std::getenv("HOME");
+            if (!home || !*home) {
+                return "";
+            }
+            std::string dir = std::string(home) + "/.cache";
+            mkdir(dir.c_str(), 0755);
+            return dir + "/deep_learning_gemm.cache";
+        }
+
+        template <typename T>
+        static std::string Key(const Shape & shape) {
+            std::ostringstream key;
+            key << shape.M << " " << shape.N << " " << shape.K << " " << DType<T>::name() << " " << shape.transA
+                << " " << shape.transB;
+            return key.str();
+        }
+
+        // the inverse of Key, for the dtypes the cache can hold
+        static bool ParseKey(const std::string & key, Shape & shape) {
+            std::istringstream fields(key);
+            std::string dtype;
+            if (!(fields >> shape.M >> shape.N >> shape.K >> dtype >> shape.transA >> shape.transB)) {
+                return false;
+            }
+            if (dtype == DType<float>::name()) {
+                shape.dtype = DType<float>::id;
+            } else if (dtype == DType<double>::name()) {
+                shape.dtype = DType<double>::id;
+            } else if (dtype.size() > 1 && dtype[0] == 't') {
+                shape.dtype = std::atoi(dtype.c_str() + 1);
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        static std::string CpuModel() {
+            std::string model;
+#ifdef __APPLE__
+            char brand[256];
+            size_t len = sizeof(brand);
+            if (sysctlbyname("machdep.cpu.brand_string", brand, &len, nullptr, 0) == 0) {
+                model = brand;
+            }
+#else
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::string line;
+            while (std::getline(cpuinfo, line)) {
+                if (line.compare(0, 10, "model name") == 0) {
+                    model = line.substr(line.find(':') + 1);
+                    break;
+                }
+            }
+#endif
+            // the model is the first tab-separated field of the cache
+            size_t begin = model.find_first_not_of(" \t");
+            model = begin == std::string::npos ? "unknown" : model.substr(begin);
+            std::replace(model.begin(), model.end(), '\t', ' ');
+            return model;
+        }
+
+        void Load() {
+            if (cache_path.empty()) {
+                return;
+            }
+            std::ifstream cache(cache_path);
+            std::string line;
+            while (std::getline(cache, line)) {
+                std::istringstream fields(line);
+                std::string model, key, values;
+                if (!std::getline(fields, model, '\t') || !std::getline(fields, key, '\t') ||
+                    !std::getline(fields, values) || model != cpu_model) {
+                    continue;
+                }
+                Shape shape;
+                Config config;
+                std::istringstream parse(values);
+                if (ParseKey(key, shape) &&
+                    parse >> config.mc >> config.nc >> config.kc >> config.order >> config.threads) {
+                    __configs[shape] = config;
+                }
+            }
+        }
+
+        static std::vector<Config> Candidates(size_t M, size_t N, size_t K) {
+            std::vector<size_t> threads = {1};
+            size_t nCores = std::thread::hardware_concurrency();
+            for (size_t t = 2; t <= nCores && t <= M; t *= 2) {
+                threads.push_back(t);
+            }
+            std::vector<Config> candidates;
+            for (int order : {IKJ, IJK}) {
+                for (size_t mc : {(size_t)0, (size_t)32}) {
+                    if (mc && mc >= M) {
+                        continue;
+                    }
+                    for (size_t kc : {(size_t)0, (size_t)64, (size_t)256}) {
+                        if (kc && kc >= K) {
+                            continue;
+                        }
+                        for (size_t nc : {(size_t)0, (size_t)256}) {
+                            if (nc && nc >= N) {
+                                continue;
+                            }
+                            for (size_t t : threads) {
+                                Config config = {mc, nc, kc, order, t};
+                                candidates.push_back(config);
+                            }
+                        }
+                    }
+                }
+            }
+            return candidates;
+        }
+
+        template <typename T>
+        static Config Tune(const Kernel<T> & kernel, size_t M, size_t N, size_t K) {
+            typedef std::chrono::steady_clock Clock;
+            const auto budget = std::chrono::milliseconds(2);
+            const size_t maxReps = 64;
+
+            Config best = DefaultConfig();
+            double bestSeconds = -1;
+            for (const Config & config : Candidates(M, N, K)) {
+                kernel.Run(config); // warm-up
+                size_t reps = 0;
+                auto start = Clock::now();
+                do {
+                    kernel.Run(config);
+                    ++reps;
+                } while (reps < maxReps && Clock::now() - start < budget);
+                double seconds = std::chrono::duration<double>(Clock::now() - start).count() / reps;
+                if (bestSeconds < 0 || seconds < bestSeconds) {
+                    bestSeconds = seconds;
+                    best = config;
+                }
+            }
+            return best;
+        }
+
+        pid_t __owner;
+        __ConfigMap __configs;
+        mutable std::mutex __mutex;
+    };
+
+    template <typename T>
+    inline void Dot(size_t M, size_t N, size_t K,
+                    const T * A, bool transA,
+                    const T * B, bool transB,
+                    T * C) {
+        Autotuner::Instance().Dot(M, N, K, A, transA, B, transB, C);
+    }
+
+    template <typename T, typename __ParallelFor>
+    inline void BatchedDot(size_t count, size_t M, size_t N, size_t K,
+                           const T * const * A, bool transA,
+                           const T * const * B, bool transB,
+                           T * const * C,
+                           __ParallelFor parallel_for) {
+        Autotuner::Instance().BatchedDot(count, M, N, K, A, transA, B, transB, C, parallel_for);
+    }
+}
+
+#endif //DEEP_LEARNING_AUTOTUNER_H
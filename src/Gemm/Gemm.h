@@ -0,0 +1,128 @@
+#ifndef DEEP_LEARNING_GEMM_H
+#define DEEP_LEARNING_GEMM_H
+
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+namespace gemm {
+    enum LoopOrder {
+        IKJ = 0, // streams rows of B and C, best when B is not transposed
+        IJK = 1  // dot product per C element, best when A rows and B columns are contiguous
+    };
+
+    // One point of the kernel search space. mc/nc/kc are the block sizes along M/N/K
+    // (0 means no blocking along that axis), threads splits the rows of C.
+    struct Config {
+        size_t mc, nc, kc;
+        int order;
+        size_t threads;
+    };
+
+    inline Config DefaultConfig() {
+        Config config = {0, 0, 0, IKJ, 1};
+        return config;
+    }
+
+    // C(M, N) = op(A) * op(B), where op(A) is (M, K) and op(B) is (K, N). A is stored
+    // row-major as (M, K), or as (K, M) when transA; B likewise as (K, N) or (N, K).
+    template <typename T>
+    class Kernel {
+    public:
+        Kernel(size_t M, size_t N, size_t K,
+               const T * A, bool transA,
+               const T * B, bool transB,
+               T * C)
+                : M(M), N(N), K(K), A(A), B(B), C(C),
+                  a_is(transA ? 1 : K), a_ks(transA ? M : 1),
+                  b_ks(transB ? 1 : N), b_js(transB ? K : 1) {}
+
+        void Run(const Config & config) const {
+            size_t nThreads = std::max<size_t>(1, std::min(config.threads, M));
+            if (nThreads == 1) {
+                Rows(config, 0, M);
+                return;
+            }
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < nThreads; ++t) {
+                workers.emplace_back(&Kernel::Rows, this, std::cref(config), t * M / nThreads, (t + 1) * M / nThreads);
+            }
+            Rows(config, 0, M / nThreads);
+            for (auto & worker : workers) {
+                worker.join();
+            }
+        }
+
+    private:
+        void Rows(const Config & config, size_t i0, size_t i1) const {
+            for (size_t i = i0; i < i1; ++i) {
+                std::fill(C + i * N, C + (i + 1) * N, T(0));
+            }
+            const size_t mc = config.mc ? config.mc : M;
+            const size_t nc = config.nc ? config.nc : N;
+            const size_t kc = config.kc ? config.kc : K;
+            for (size_t ii = i0; ii < i1; ii += mc) {
+                const size_t ie = std::min(ii + mc, i1);
+                for (size_t jj = 0; jj < N; jj += nc) {
+                    const size_t je = std::min(jj + nc, N);
+                    for (size_t kk = 0; kk < K; kk += kc) {
+                        const size_t ke = std::min(kk + kc, K);
+                        if (config.order == IJK) {
+                            BlockIJK(ii, ie, jj, je, kk, ke);
+                        } else {
+                            BlockIKJ(ii, ie, jj, je, kk, ke);
+                        }
+                    }
+                }
+            }
+        }
+
+        void BlockIKJ(size_t ii, size_t ie, size_t jj, size_t je, size_t kk, size_t ke) const {
+            for (size_t i = ii; i < ie; ++i) {
+                T * c = C + i * N;
+                for (size_t k = kk; k < ke; ++k) {
+                    const T a = A[i * a_is + k * a_ks];
+                    const T * b = B + k * b_ks;
+                    if (b_js == 1) {
+                        for (size_t j = jj; j < je; ++j) {
+                            c[j] += a * b[j];
+                        }
+                    } else {
+                        for (size_t j = jj; j < je; ++j) {
+                            c[j] += a * b[j * b_js];
+                        }
+                    }
+                }
+            }
+        }
+
+        void BlockIJK(size_t ii, size_t ie, size_t jj, size_t je, size_t kk, size_t ke) const {
+            for (size_t i = ii; i < ie; ++i) {
+                const T * a = A + i * a_is;
+                for (size_t j = jj; j < je; ++j) {
+                    const T * b = B + j * b_js;
+                    T sum = 0;
+                    if (a_ks == 1 && b_ks == 1) {
+                        for (size_t k = kk; k < ke; ++k) {
+                            sum += a[k] * b[k];
+                        }
+                    } else {
+                        for (size_t k = kk; k < ke; ++k) {
+                            sum += a[k * a_ks] * b[k * b_ks];
+                        }
+                    }
+                    C[i * N + j] += sum;
+                }
+            }
+        }
+
+        size_t M, N, K;
+        const T * A;
+        const T * B;
+        T * C;
+        size_t a_is, a_ks, b_ks, b_js;
+    };
+}
+
+#endif //DEEP_LEARNING_GEMM_H
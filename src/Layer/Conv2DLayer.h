@@ -0,0 +1,166 @@
+#ifndef DEEP_LEARNING_CONV2DLAYER_H
+#define DEEP_LEARNING_CONV2DLAYER_H
+
+#include "../Matrix.h"
+
+// 2D convolution lowered onto Matrix::dot with im2col.
+// A feature map with C channels of H x W pixels is stored as a (C, H * W) matrix,
+// so a 28x28 gray image is x_train(i) reshaped to (1, 784).
+template <typename T>
+class Conv2DLayer {
+public:
+    Conv2DLayer(size_t in_channels,
+                size_t out_channels,
+                size_t in_rows,
+                size_t in_cols,
+                size_t kernel_size,
+                size_t stride=1,
+                size_t padding=0)
+            : in_channels(in_channels),
+              out_channels(out_channels),
+              in_rows(in_rows),
+              in_cols(in_cols),
+              kernel_size(kernel_size),
+              stride(stride),
+              padding(padding),
+              out_rows((in_rows + 2 * padding - kernel_size) / stride + 1),
+              out_cols((in_cols + 2 * padding - kernel_size) / stride + 1),
+              weights_(out_channels, in_channels * kernel_size * kernel_size),
+              bias_(out_channels, 1),
+              outputs_(0, 0),
+              grads_(0, 0),
+              weights_grads_(0, 0),
+              bias_grads_(out_channels, 1),
+              input_grads_(in_channels, in_rows * in_cols),
+              __cols(in_channels * kernel_size * kernel_size, out_rows * out_cols, false) {}
+
+    template <typename __Gen>
+    Conv2DLayer(size_t in_channels,
+                size_t out_channels,
+                size_t in_rows,
+                size_t in_cols,
+                size_t kernel_size,
+                size_t stride,
+                size_t padding,
+                __Gen generator)
+            : in_channels(in_channels),
+              out_channels(out_channels),
+              in_rows(in_rows),
+              in_cols(in_cols),
+              kernel_size(kernel_size),
+              stride(stride),
+              padding(padding),
+              out_rows((in_rows + 2 * padding - kernel_size) / stride + 1),
+              out_cols((in_cols + 2 * padding - kernel_size) / stride + 1),
+              weights_(out_channels, in_channels * kernel_size * kernel_size, generator),
+              bias_(out_channels, 1, generator),
+              outputs_(0, 0),
+              grads_(0, 0),
+              weights_grads_(0, 0),
+              bias_grads_(out_channels, 1),
+              input_grads_(in_channels, in_rows * in_cols),
+              __cols(in_channels * kernel_size * kernel_size, out_rows * out_cols, false) {}
+
+    void Forward(const matrix::Matrix<T> & inputs_) {
+        assert(inputs_.nrow == in_channels && inputs_.ncol == in_rows * in_cols);
+        im2col(inputs_);
+        outputs_ = weights_.dot(__cols);
+        T * out = outputs_.data();
+        const size_t nOutArea = out_rows * out_cols;
+        for (size_t c = 0; c < out_channels; ++c) {
+            const T b = bias_(c, 0);
+            for (size_t i = 0; i < nOutArea; ++i) {
+                out[c * nOutArea + i] += b;
+            }
+        }
+    }
+
+    // output_grads_ is dL/da of this layer's activation and active_grads_ is f'(z),
+    // both shaped like outputs_. Must follow the Forward of the same sample, whose
+    // im2col workspace it reuses.
+    void Backward(const matrix::Matrix<T> & output_grads_, const matrix::Matrix<T> & active_grads_) {
+        grads_ = output_grads_ * active_grads_;
+        weights_grads_ = grads_.dot(__cols, false, true);
+
+        const T * delta = grads_.data();
+        const size_t nOutArea = out_rows * out_cols;
+        for (size_t c = 0; c < out_channels; ++c) {
+            T sum = 0;
+            for (size_t i = 0; i < nOutArea; ++i) {
+                sum += delta[c * nOutArea + i];
+            }
+            bias_grads_(c, 0) = sum;
+        }
+
+        col2im(weights_.dot(grads_, true, false));
+    }
+
+    size_t in_channels, out_channels;
+    size_t in_rows, in_cols;
+    size_t kernel_size, stride, padding;
+    size_t out_rows, out_cols;
+    matrix::Matrix<T> weights_; //W, (out_channels, in_channels * k * k)
+    matrix::Matrix<T> bias_; //b, (out_channels, 1)
+    matrix::Matrix<T> outputs_; //z, (out_channels, out_rows * out_cols)
+    matrix::Matrix<T> grads_; //\delta, shaped like outputs_
+    matrix::Matrix<T> weights_grads_; //dL/dW
+    matrix::Matrix<T> bias_grads_; //dL/db
+    matrix::Matrix<T> input_grads_; //dL/dx, shaped like the inputs
+
+private:
+    // Each column of __cols holds the receptive field of one output pixel; the buffer is
+    // allocated once in the constructor and rewritten in place for every sample.
+    void im2col(const matrix::Matrix<T> & inputs_) {
+        const T * in = inputs_.data();
+        T * cols = __cols.data();
+        const size_t nOutArea = out_rows * out_cols;
+        for (size_t c = 0; c < in_channels; ++c) {
+            for (size_t ki = 0; ki < kernel_size; ++ki) {
+                for (size_t kj = 0; kj < kernel_size; ++kj) {
+                    T * row = cols + ((c * kernel_size + ki) * kernel_size + kj) * nOutArea;
+                    for (size_t oi = 0; oi < out_rows; ++oi) {
+                        const long r = (long)(oi * stride + ki) - (long)padding;
+                        for (size_t oj = 0; oj < out_cols; ++oj) {
+                            const long s = (long)(oj * stride + kj) - (long)padding;
+                            if (r < 0 || r >= (long)in_rows || s < 0 || s >= (long)in_cols) {
+                                row[oi * out_cols + oj] = 0;
+                            } else {
+                                row[oi * out_cols + oj] = in[(c * in_rows + r) * in_cols + s];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void col2im(const matrix::Matrix<T> & col_grads_) {
+        const T * cols = col_grads_.data();
+        input_grads_.setZero();
+        T * in = input_grads_.data();
+        const size_t nOutArea = out_rows * out_cols;
+        for (size_t c = 0; c < in_channels; ++c) {
+            for (size_t ki = 0; ki < kernel_size; ++ki) {
+                for (size_t kj = 0; kj < kernel_size; ++kj) {
+                    const T * row = cols + ((c * kernel_size + ki) * kernel_size + kj) * nOutArea;
+                    for (size_t oi = 0; oi < out_rows; ++oi) {
+                        const long r = (long)(oi * stride + ki) - (long)padding;
+                        if (r < 0 || r >= (long)in_rows) {
+                            continue;
+                        }
+                        for (size_t oj = 0; oj < out_cols; ++oj) {
+                            const long s = (long)(oj * stride + kj) - (long)padding;
+                            if (s >= 0 && s < (long)in_cols) {
+                                in[(c * in_rows + r) * in_cols + s] += row[oi * out_cols + oj];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    matrix::Matrix<T> __cols;
+};
+
+#endif //DEEP_LEARNING_CONV2DLAYER_H
@@ -47,15 +47,23 @@ public:
         }
     }
 
+    // inputs_ is one sample per column; the bias is added to every column
     void Forward(const matrix::Matrix<T> & inputs_) {
-        outputs_ = weights_.dot(inputs_) + bias_;
+        outputs_ = weights_.dot(inputs_);
+        T * out = outputs_.data();
+        for (size_t i = 0; i < n_neurons; ++i) {
+            const T b = bias_(i, 0);
+            for (size_t j = 0; j < inputs_.ncol; ++j) {
+                out[i * inputs_.ncol + j] += b;
+            }
+        }
     }
 
     void Backward(const matrix::Matrix<T> & input_weights_, matrix::Matrix<T> & input_grads_, matrix::Matrix<T> & active_grads_) {
         if (input_weights_.isEmpty()) {
             grads_ = input_grads_ * active_grads_;
         } else {
-            grads_ = input_weights_.t().dot(input_grads_) * active_grads_;
+            grads_ = input_weights_.dot(input_grads_, true, false) * active_grads_;
         }
     }
 
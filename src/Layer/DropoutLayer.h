@@ -0,0 +1,81 @@
+#ifndef DEEP_LEARNING_DROPOUTLAYER_H
+#define DEEP_LEARNING_DROPOUTLAYER_H
+
+#include <vector>
+#include <cstdint>
+#include "../Matrix.h"
+#include "../Random/Philox.h"
+
+// Inverted dropout: in training every element is zeroed with probability rate and the
+// survivors are scaled by 1 / (1 - rate), so inference is the identity.
+//
+// The mask is drawn from Philox with one stream per Forward call, so a run is
+// reproducible from its seed whatever the thread count, and it is kept bit-packed
+// (one bit per element instead of a T) until Backward.
+template <typename T>
+class DropoutLayer {
+public:
+    DropoutLayer(T rate, uint64_t seed)
+            : rate(rate),
+              seed(seed),
+              outputs_(0, 0),
+              grads_(0, 0),
+              __philox(seed),
+              __step(0),
+              __training(false) {
+        assert(rate >= 0 && rate < 1);
+    }
+
+    void Forward(const matrix::Matrix<T> & inputs_, bool training=true) {
+        __training = training && rate > 0;
+        outputs_ = inputs_;
+        if (!__training) {
+            return;
+        }
+
+        const size_t n = inputs_.size;
+        const uint64_t threshold = (uint64_t)((1 - rate) * 4294967296.0);
+        const T scale = 1 / (1 - rate);
+        __mask.assign((n + 31) / 32, 0);
+        std::vector<uint32_t> words(32);
+        T * out = outputs_.data();
+        for (size_t w = 0; w < __mask.size(); ++w) {
+            size_t nBits = std::min<size_t>(32, n - w * 32);
+            __philox.Fill(__step, w * 32, words.data(), nBits);
+            uint32_t bits = 0;
+            for (size_t b = 0; b < nBits; ++b) {
+                uint32_t keep = words[b] < threshold;
+                bits |= keep << b;
+                out[w * 32 + b] = keep ? out[w * 32 + b] * scale : 0;
+            }
+            __mask[w] = bits;
+        }
+        ++__step;
+    }
+
+    // output_grads_ is dL/d(outputs_); grads_ becomes dL/d(inputs_)
+    void Backward(const matrix::Matrix<T> & output_grads_) {
+        grads_ = output_grads_;
+        if (!__training) {
+            return;
+        }
+        const T scale = 1 / (1 - rate);
+        T * grads = grads_.data();
+        for (size_t i = 0; i < grads_.size; ++i) {
+            grads[i] = ((__mask[i / 32] >> (i % 32)) & 1) ? grads[i] * scale : 0;
+        }
+    }
+
+    T rate;
+    uint64_t seed;
+    matrix::Matrix<T> outputs_;
+    matrix::Matrix<T> grads_;
+
+private:
+    rng::Philox __philox;
+    uint64_t __step;
+    bool __training;
+    std::vector<uint32_t> __mask;
+};
+
+#endif //DEEP_LEARNING_DROPOUTLAYER_H
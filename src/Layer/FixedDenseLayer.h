@@ -0,0 +1,62 @@
+#ifndef DEEP_LEARNING_FIXEDDENSELAYER_H
+#define DEEP_LEARNING_FIXEDDENSELAYER_H
+
+#include "../Matrix.h"
+#include "../FixedMatrix.h"
+
+// DenseLayer with its shape fixed at compile time. All members are FixedMatrix,
+// so Forward/Backward never touch the heap.
+template <typename T, size_t LAST_N_NEURONS, size_t N_NEURONS>
+class FixedDenseLayer {
+public:
+    static constexpr size_t last_n_neurons = LAST_N_NEURONS;
+    static constexpr size_t n_neurons = N_NEURONS;
+
+    typedef matrix::FixedMatrix<T, N_NEURONS, 1> Vector;
+    typedef matrix::FixedMatrix<T, LAST_N_NEURONS, 1> InputVector;
+
+    FixedDenseLayer() = default;
+
+    template <typename __Gen>
+    explicit FixedDenseLayer(__Gen generator)
+            : weights_(generator),
+              bias_(generator) {}
+
+    void Forward(const InputVector & inputs_) {
+        outputs_ = weights_.dot(inputs_) + bias_;
+    }
+
+    void Forward(const matrix::Matrix<T> & inputs_) {
+        Forward(InputVector(inputs_));
+    }
+
+    // output layer: \delta = dL/dz * f'(z)
+    void Backward(const Vector & input_grads_, const Vector & active_grads_) {
+        grads_ = input_grads_ * active_grads_;
+    }
+
+    // hidden layer: \delta = W_next^T \delta_next * f'(z)
+    template <size_t NEXT_N_NEURONS>
+    void Backward(const matrix::FixedMatrix<T, NEXT_N_NEURONS, N_NEURONS> & input_weights_,
+                  const matrix::FixedMatrix<T, NEXT_N_NEURONS, 1> & input_grads_,
+                  const Vector & active_grads_) {
+        grads_ = input_weights_.t().dot(input_grads_) * active_grads_;
+    }
+
+    // W^T \delta, i.e. what the previous (possibly dynamic) layer multiplies with its f'(z)
+    InputVector InputGrads() const {
+        return weights_.t().dot(grads_);
+    }
+
+    matrix::FixedMatrix<T, N_NEURONS, LAST_N_NEURONS> weights_; //W
+    Vector bias_; //b
+    Vector outputs_; //z
+    Vector grads_; //\delta
+};
+
+template <typename T, size_t LAST_N_NEURONS, size_t N_NEURONS>
+constexpr size_t FixedDenseLayer<T, LAST_N_NEURONS, N_NEURONS>::last_n_neurons;
+template <typename T, size_t LAST_N_NEURONS, size_t N_NEURONS>
+constexpr size_t FixedDenseLayer<T, LAST_N_NEURONS, N_NEURONS>::n_neurons;
+
+#endif //DEEP_LEARNING_FIXEDDENSELAYER_H
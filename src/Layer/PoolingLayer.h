@@ -0,0 +1,136 @@
+#ifndef DEEP_LEARNING_POOLINGLAYER_H
+#define DEEP_LEARNING_POOLINGLAYER_H
+
+#include <vector>
+#include "../Matrix.h"
+
+// Pooling over (channels, rows * cols) feature maps, the layout used by Conv2DLayer.
+template <typename T>
+class MaxPool2DLayer {
+public:
+    MaxPool2DLayer(size_t channels,
+                   size_t in_rows,
+                   size_t in_cols,
+                   size_t pool_size)
+            : channels(channels),
+              in_rows(in_rows),
+              in_cols(in_cols),
+              pool_size(pool_size),
+              out_rows(in_rows / pool_size),
+              out_cols(in_cols / pool_size),
+              outputs_(channels, out_rows * out_cols, false),
+              input_grads_(channels, in_rows * in_cols),
+              __max_index(channels * out_rows * out_cols) {}
+
+    void Forward(const matrix::Matrix<T> & inputs_) {
+        assert(inputs_.nrow == channels && inputs_.ncol == in_rows * in_cols);
+        const T * in = inputs_.data();
+        T * out = outputs_.data();
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t oi = 0; oi < out_rows; ++oi) {
+                for (size_t oj = 0; oj < out_cols; ++oj) {
+                    size_t best = (c * in_rows + oi * pool_size) * in_cols + oj * pool_size;
+                    for (size_t pi = 0; pi < pool_size; ++pi) {
+                        for (size_t pj = 0; pj < pool_size; ++pj) {
+                            size_t idx = (c * in_rows + oi * pool_size + pi) * in_cols + oj * pool_size + pj;
+                            if (in[idx] > in[best]) {
+                                best = idx;
+                            }
+                        }
+                    }
+                    size_t o = (c * out_rows + oi) * out_cols + oj;
+                    out[o] = in[best];
+                    __max_index[o] = best;
+                }
+            }
+        }
+    }
+
+    // routes each output gradient back to the input that won the max
+    void Backward(const matrix::Matrix<T> & output_grads_) {
+        assert(output_grads_.size == outputs_.size);
+        input_grads_.setZero();
+        const T * grads = output_grads_.data();
+        T * in = input_grads_.data();
+        for (size_t o = 0; o < outputs_.size; ++o) {
+            in[__max_index[o]] += grads[o];
+        }
+    }
+
+    size_t channels;
+    size_t in_rows, in_cols;
+    size_t pool_size;
+    size_t out_rows, out_cols;
+    matrix::Matrix<T> outputs_;
+    matrix::Matrix<T> input_grads_;
+
+private:
+    std::vector<size_t> __max_index;
+};
+
+template <typename T>
+class AvgPool2DLayer {
+public:
+    AvgPool2DLayer(size_t channels,
+                   size_t in_rows,
+                   size_t in_cols,
+                   size_t pool_size)
+            : channels(channels),
+              in_rows(in_rows),
+              in_cols(in_cols),
+              pool_size(pool_size),
+              out_rows(in_rows / pool_size),
+              out_cols(in_cols / pool_size),
+              outputs_(channels, out_rows * out_cols, false),
+              input_grads_(channels, in_rows * in_cols) {}
+
+    void Forward(const matrix::Matrix<T> & inputs_) {
+        assert(inputs_.nrow == channels && inputs_.ncol == in_rows * in_cols);
+        const T * in = inputs_.data();
+        T * out = outputs_.data();
+        const T scale = T(1) / (pool_size * pool_size);
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t oi = 0; oi < out_rows; ++oi) {
+                for (size_t oj = 0; oj < out_cols; ++oj) {
+                    T sum = 0;
+                    for (size_t pi = 0; pi < pool_size; ++pi) {
+                        for (size_t pj = 0; pj < pool_size; ++pj) {
+                            sum += in[(c * in_rows + oi * pool_size + pi) * in_cols + oj * pool_size + pj];
+                        }
+                    }
+                    out[(c * out_rows + oi) * out_cols + oj] = sum * scale;
+                }
+            }
+        }
+    }
+
+    // spreads each output gradient evenly over its pooling window
+    void Backward(const matrix::Matrix<T> & output_grads_) {
+        assert(output_grads_.size == outputs_.size);
+        input_grads_.setZero();
+        const T * grads = output_grads_.data();
+        T * in = input_grads_.data();
+        const T scale = T(1) / (pool_size * pool_size);
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t oi = 0; oi < out_rows; ++oi) {
+                for (size_t oj = 0; oj < out_cols; ++oj) {
+                    T g = grads[(c * out_rows + oi) * out_cols + oj] * scale;
+                    for (size_t pi = 0; pi < pool_size; ++pi) {
+                        for (size_t pj = 0; pj < pool_size; ++pj) {
+                            in[(c * in_rows + oi * pool_size + pi) * in_cols + oj * pool_size + pj] += g;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    size_t channels;
+    size_t in_rows, in_cols;
+    size_t pool_size;
+    size_t out_rows, out_cols;
+    matrix::Matrix<T> outputs_;
+    matrix::Matrix<T> input_grads_;
+};
+
+#endif //DEEP_LEARNING_POOLINGLAYER_H
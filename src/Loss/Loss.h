@@ -7,6 +7,7 @@
 
 #include <cmath>
 #include "../Matrix.h"
+#include "../FixedMatrix.h"
 
 template <typename T>
 class SoftMaxLoss {
@@ -14,15 +15,47 @@ public:
     SoftMaxLoss() : __grads(0, 0) {}
     ~SoftMaxLoss() = default;
 
-    size_t Forward(matrix::Matrix<T> & inputs_, size_t label, T & loss) {
+    size_t Forward(const matrix::Matrix<T> & inputs_, size_t label, T & loss) {
         assert(inputs_.ncol == 1);
         T inputs_max = inputs_.max_element();
         matrix::Matrix<T> exps(inputs_.nrow, 1);
         for (size_t i = 0; i < inputs_.nrow; ++i) {
             exps(i, 0) = std::exp(inputs_(i, 0) - inputs_max);
         }
-        auto Sum = 0.0;
-        for (size_t i = 0; i < inputs_.nrow; ++i) {
+        exps /= exps.sum();
+
+        loss = -log(exps(label, 0) + 1e-10);
+
+        __grads = exps;
+        __grads(label, 0) -= 1;
+
+        return exps.max_index().first;
+    }
+
+    matrix::Matrix<T> grad_() {
+        return __grads;
+    }
+
+private:
+    matrix::Matrix<T> __grads;
+
+};
+
+template <typename T, size_t N>
+class FixedSoftMaxLoss {
+public:
+    typedef matrix::FixedMatrix<T, N, 1> Vector;
+
+    FixedSoftMaxLoss() = default;
+    ~FixedSoftMaxLoss() = default;
+
+    size_t Forward(const Vector & inputs_, size_t label, T & loss) {
+        assert(label < N);
+        T inputs_max = inputs_.max_element();
+        Vector exps(false);
+        T Sum = 0;
+        for (size_t i = 0; i < N; ++i) {
+            exps(i, 0) = std::exp(inputs_(i, 0) - inputs_max);
             Sum += exps(i, 0);
         }
         exps /= Sum;
@@ -35,12 +68,12 @@ public:
         return exps.max_index().first;
     }
 
-    matrix::Matrix<T> grad_() {
+    const Vector & grad_() const {
         return __grads;
     }
 
 private:
-    matrix::Matrix<T> __grads;
+    Vector __grads;
 
 };
 #endif //DEEP_LEARNING_LOSS_H
@@ -6,8 +6,11 @@
 #define DEEP_LEARNING_MATRIX_H
 
 #include <vector>
+#include <cassert>
 #include <cstdio>
 #include <utility>
+#include "Gemm/Autotuner.h"
+#include "Reduction/Reduction.h"
 
 namespace matrix {
     template <typename T>
@@ -67,12 +70,64 @@ namespace matrix {
             return row;
         }
 
+        Matrix(const Matrix<T> & other) : nrow(other.nrow), ncol(other.ncol), size(other.size) {
+            __data = new T[size];
+            for (size_t i = 0; i < size; ++i) {
+                __data[i] = other.__data[i];
+            }
+        }
+        Matrix(Matrix<T> && other) noexcept
+                : nrow(other.nrow), ncol(other.ncol), size(other.size), __data(other.__data) {
+            other.nrow = other.ncol = other.size = 0;
+            other.__data = nullptr;
+        }
+        ~Matrix() {
+            delete[] __data;
+        }
+
+        // copies a (1, ncol) or (ncol, 1) vector into row i
+        inline void setRow(size_t i, const Matrix<T> & row) {
+            assert(row.size == ncol);
+            for (size_t j = 0; j < ncol; ++j) {
+                __data[i * ncol + j] = row.__data[j];
+            }
+        }
+
+        // copies a (nrow, 1) or (1, nrow) vector into column j
+        inline void setCol(size_t j, const Matrix<T> & col) {
+            assert(col.size == nrow);
+            for (size_t i = 0; i < nrow; ++i) {
+                __data[i * ncol + j] = col.__data[i];
+            }
+        }
+
+        // copy of rows [begin, end)
+        Matrix<T> rows(size_t begin, size_t end) const {
+            assert(begin <= end && end <= nrow);
+            Matrix<T> res(end - begin, ncol, false);
+            for (size_t i = 0; i < res.size; ++i) {
+                res.__data[i] = __data[begin * ncol + i];
+            }
+            return res;
+        }
+
+        // overwrites rows [begin, begin + block.nrow) with block
+        void setRows(size_t begin, const Matrix<T> & block) {
+            assert(block.ncol == ncol && begin + block.nrow <= nrow);
+            for (size_t i = 0; i < block.size; ++i) {
+                __data[begin * ncol + i] = block.__data[i];
+            }
+        }
+
         Matrix<T> & operator=(const Matrix<T> & other) {
             if (this != &other) {
+                if (size != other.size) {
+                    delete[] __data;
+                    __data = new T[other.size];
+                }
                 nrow = other.nrow;
                 ncol = other.ncol;
                 size = nrow * ncol;
-                __data = new T[size];
                 for (size_t i = 0; i < size; ++i) {
                     __data[i] = other.__data[i];
                 }
@@ -80,19 +135,34 @@ namespace matrix {
             return *this;
         }
 
+        Matrix<T> & operator=(Matrix<T> && other) noexcept {
+            if (this != &other) {
+                delete[] __data;
+                nrow = other.nrow;
+                ncol = other.ncol;
+                size = other.size;
+                __data = other.__data;
+                other.nrow = other.ncol = other.size = 0;
+                other.__data = nullptr;
+            }
+            return *this;
+        }
+
         Matrix<T> dot(const Matrix<T> & other) const {
             assert(ncol == other.nrow);
-            const Matrix<T> & self = *this;
             Matrix<T> res(nrow, other.ncol, false);
+            gemm::Dot(nrow, other.ncol, ncol, __data, false, other.__data, false, res.__data);
+            return res;
+        }
 
-            for (size_t i = 0; i < nrow; ++i) {
-                for (size_t k = 0; k < other.ncol; ++k) {
-                    res(i, k) = 0;
-                    for (size_t j = 0; j < ncol; ++j) {
-                        res(i, k) += self(i, j) * other(j, k);
-                    }
-                }
-            }
+        // op(self).dot(op(other)) without materializing the transposes, e.g.
+        // W.dot(delta, true, false) == W.t().dot(delta)
+        Matrix<T> dot(const Matrix<T> & other, bool transSelf, bool transOther) const {
+            size_t M = transSelf ? ncol : nrow, K = transSelf ? nrow : ncol;
+            size_t N = transOther ? other.nrow : other.ncol;
+            assert(K == (transOther ? other.ncol : other.nrow));
+            Matrix<T> res(M, N, false);
+            gemm::Dot(M, N, K, __data, transSelf, other.__data, transOther, res.__data);
             return res;
         }
 
@@ -204,10 +274,28 @@ namespace matrix {
             return transpose();
         }
 
+        Matrix<T> reshape(size_t nrow_, size_t ncol_) const {
+            assert(nrow_ * ncol_ == size);
+            Matrix<T> res(nrow_, ncol_, false);
+
+            for (size_t i = 0; i < size; ++i) {
+                res.__data[i] = __data[i];
+            }
+            return res;
+        }
+
         inline bool isEmpty() const {
             return size == 0;
         }
 
+        inline T * data() {
+            return __data;
+        }
+
+        inline const T * data() const {
+            return __data;
+        }
+
         inline void setZero() {
             for (size_t i = 0; i < size; ++i) {
                 __data[i] = 0;
@@ -220,30 +308,79 @@ namespace matrix {
             }
         }
 
-        T max_element() {
+        T max_element() const {
             assert(size != 0);
-            T max = __data[0];
-            for (size_t i = 0; i < size; ++i) {
-                if (__data[i] > max) {
-                    max = __data[i];
-                }
-            }
-            return max;
+            return reduction::Max(__data, size);
         }
 
-        std::pair<size_t, size_t> max_index() {
+        T min_element() const {
             assert(size != 0);
-            T max = __data[0];
-            size_t max_index = 0;
-            for (size_t i = 0; i < size; ++i) {
-                if (__data[i] > max) {
-                    max = __data[i];
-                    max_index = i;
-                }
-            }
+            return reduction::Min(__data, size);
+        }
+
+        std::pair<size_t, size_t> max_index() const {
+            assert(size != 0);
+            size_t max_index = reduction::ArgMax(__data, size);
             return std::make_pair(max_index / ncol, max_index % ncol);
         }
 
+        // numpy-style axis reductions: axis 0 reduces every column into a (1, ncol) matrix, axis 1
+        // every row into a (nrow, 1) matrix; index, if given, gets the row (axis 0) or column
+        // (axis 1) of the first maximum / minimum
+        Matrix<T> max(int axis, std::vector<size_t> * index=nullptr) const {
+            return extremum(axis, index, reduction::MaxCols<T>, reduction::MaxRows<T>);
+        }
+
+        Matrix<T> min(int axis, std::vector<size_t> * index=nullptr) const {
+            return extremum(axis, index, reduction::MinCols<T>, reduction::MinRows<T>);
+        }
+
+        std::vector<size_t> argmax(int axis) const {
+            std::vector<size_t> index;
+            max(axis, &index);
+            return index;
+        }
+
+        std::vector<size_t> argmin(int axis) const {
+            std::vector<size_t> index;
+            min(axis, &index);
+            return index;
+        }
+
+        T sum(reduction::Accumulation acc=reduction::Pairwise) const {
+            return reduction::Sum(__data, size, acc);
+        }
+
+        // e.g. sum(1) is the bias gradient of a (n_neurons, batch) delta
+        Matrix<T> sum(int axis, reduction::Accumulation acc=reduction::Pairwise) const {
+            assert(axis == 0 || axis == 1);
+            if (axis == 0) {
+                Matrix<T> res(1, ncol, false);
+                reduction::SumCols(__data, nrow, ncol, res.__data, acc);
+                return res;
+            }
+            Matrix<T> res(nrow, 1, false);
+            reduction::SumRows(__data, nrow, ncol, res.__data, acc);
+            return res;
+        }
+
+        // L2 norm of all the elements
+        T norm() const {
+            return reduction::Norm2(__data, size);
+        }
+
+        Matrix<T> norm(int axis) const {
+            assert(axis == 0 || axis == 1);
+            if (axis == 0) {
+                Matrix<T> res(1, ncol, false);
+                reduction::Norm2Cols(__data, nrow, ncol, res.__data);
+                return res;
+            }
+            Matrix<T> res(nrow, 1, false);
+            reduction::Norm2Rows(__data, nrow, ncol, res.__data);
+            return res;
+        }
+
         void print() const {
             printf("[");
             for (size_t i = 0; i < nrow; ++i) {
@@ -266,6 +403,18 @@ namespace matrix {
 
         size_t nrow, ncol, size;
     private:
+        template <typename __Cols, typename __Rows>
+        Matrix<T> extremum(int axis, std::vector<size_t> * index, __Cols cols, __Rows rows) const {
+            assert(size != 0 && (axis == 0 || axis == 1));
+            std::vector<size_t> indices(axis == 0 ? ncol : nrow);
+            Matrix<T> res(axis == 0 ? 1 : nrow, axis == 0 ? ncol : 1, false);
+            (axis == 0 ? cols : rows)(__data, nrow, ncol, res.__data, indices.data());
+            if (index) {
+                index->swap(indices);
+            }
+            return res;
+        }
+
         T* __data;
     };
 }
@@ -0,0 +1,101 @@
+#ifndef DEEP_LEARNING_HOGWILD_H
+#define DEEP_LEARNING_HOGWILD_H
+
+#include <random>
+#include <thread>
+#include <vector>
+#include "../Matrix.h"
+#include "../Loss/Loss.h"
+#include "../Layer/DenseLayer.h"
+#include "Optimization.h"
+
+// Lock-free asynchronous SGD (Hogwild!) for the two-layer dense network of test_dnn.
+// Every thread samples its own images, runs forward/backward against the shared
+// fc1/fc2 parameters and applies a GradientDescent step to them right away: there is
+// no barrier, no gradient reduction and no lock. Concurrent updates race on purpose;
+// with sparse-ish inputs a lost update only costs a little progress.
+//
+// The shared DenseLayer objects are only read through weights_/bias_: outputs_ and
+// grads_ are per-sample state and live on each thread's stack instead.
+template <typename T, template <typename> class __Act>
+class Hogwild {
+public:
+    Hogwild(DenseLayer<T> & fc1, DenseLayer<T> & fc2, size_t n_threads)
+            : fc1(fc1), fc2(fc2), n_threads(n_threads), loss_(0), precision_(0) {}
+
+    // Runs n_samples single-sample SGD steps in total, split evenly over the threads.
+    void Train(const matrix::Matrix<T> & x_train,
+               const matrix::Matrix<T> & y_train,
+               size_t n_samples,
+               T learning_rate,
+               unsigned seed) {
+        std::vector<T> fLossSums(n_threads, 0);
+        std::vector<size_t> nCorrecteds(n_threads, 0);
+        std::vector<std::thread> workers;
+        for (size_t tid = 0; tid < n_threads; ++tid) {
+            size_t nSteps = n_samples / n_threads + (tid < n_samples % n_threads);
+            workers.emplace_back(&Hogwild::Worker, this, std::cref(x_train), std::cref(y_train),
+                                 nSteps, learning_rate, seed + (unsigned)tid,
+                                 std::ref(fLossSums[tid]), std::ref(nCorrecteds[tid]));
+        }
+        for (auto & worker : workers) {
+            worker.join();
+        }
+
+        T fLossSum = 0;
+        size_t nCorrected = 0;
+        for (size_t tid = 0; tid < n_threads; ++tid) {
+            fLossSum += fLossSums[tid];
+            nCorrected += nCorrecteds[tid];
+        }
+        loss_ = fLossSum / (T)n_samples;
+        precision_ = nCorrected / (T)n_samples;
+    }
+
+    DenseLayer<T> & fc1;
+    DenseLayer<T> & fc2;
+    size_t n_threads;
+    T loss_; // mean training loss of the last Train
+    T precision_; // training precision of the last Train
+
+private:
+    void Worker(const matrix::Matrix<T> & x_train,
+                const matrix::Matrix<T> & y_train,
+                size_t n_steps,
+                T learning_rate,
+                unsigned seed,
+                T & fLossSum,
+                size_t & nCorrected) {
+        std::mt19937 rg(seed);
+        __Act<T> act;
+        SoftMaxLoss<T> loss;
+        GradientDescent<T> opt;
+        T fLoss;
+        for (size_t step = 0; step < n_steps; ++step) {
+            size_t iImg = rg() % x_train.nrow;
+            auto label = (size_t)y_train(iImg, 0);
+
+            // forward, reading whatever the other threads have written so far
+            matrix::Matrix<T> img = x_train(iImg);
+            matrix::Matrix<T> fc1_outputs_ = fc1.weights_.dot(img, false, true) + fc1.bias_;
+            matrix::Matrix<T> outputs_ = act.Forward(fc1_outputs_); //a_fc1
+            matrix::Matrix<T> fc2_outputs_ = fc2.weights_.dot(outputs_) + fc2.bias_;
+            size_t nPred = loss.Forward(fc2_outputs_, label, fLoss);
+
+            // backward
+            matrix::Matrix<T> fc2_grads_ = loss.grad_();
+            matrix::Matrix<T> fc1_grads_ = fc2.weights_.dot(fc2_grads_, true, false) * act.grad_();
+
+            fLossSum += fLoss;
+            nCorrected += (nPred == label);
+
+            // unsynchronized in-place updates of the shared parameters
+            matrix::Matrix<T> fc2WeightsGrads = fc2_grads_.dot(outputs_, false, true);
+            opt.Update(fc2.weights_, fc2.bias_, fc2WeightsGrads, fc2_grads_, learning_rate);
+            matrix::Matrix<T> fc1WeightsGrads = fc1_grads_.dot(img);
+            opt.Update(fc1.weights_, fc1.bias_, fc1WeightsGrads, fc1_grads_, learning_rate);
+        }
+    }
+};
+
+#endif //DEEP_LEARNING_HOGWILD_H
@@ -0,0 +1,99 @@
+#ifndef DEEP_LEARNING_MINIBATCH_H
+#define DEEP_LEARNING_MINIBATCH_H
+
+#include <vector>
+#include "../Matrix.h"
+#include "../Loss/Loss.h"
+#include "../Layer/DenseLayer.h"
+#include "../Layer/DropoutLayer.h"
+#include "Optimization.h"
+
+// One synchronous mini-batch SGD step of the two-layer dense network of test_dnn, with an
+// optional dropout after the activation. The batch goes through every layer as one GEMM and
+// every layer's gradient is one GEMM plus a row sum.
+template <typename T, template <typename> class __Act>
+class MiniBatchStep {
+public:
+    MiniBatchStep(DenseLayer<T> & fc1, DenseLayer<T> & fc2, DropoutLayer<T> * dropout=nullptr)
+            : fc1(fc1),
+              fc2(fc2),
+              dropout(dropout),
+              fc1WeightsGrads(0, 0),
+              fc1BiasGrads(0, 0),
+              fc2WeightsGrads(0, 0),
+              fc2BiasGrads(0, 0),
+              loss_(0),
+              precision_(0) {}
+
+    // Forward and backward over batchImgs, one sample per column. Leaves the gradients
+    // summed over the batch in fc*Grads, and the batch loss and precision.
+    void Backward(const matrix::Matrix<T> & batchImgs, const std::vector<size_t> & labels) {
+        const size_t nBatch = labels.size();
+        assert(batchImgs.ncol == nBatch);
+
+        fc1.Forward(batchImgs);
+        matrix::Matrix<T> outputs_ = __act.Forward(fc1.outputs_); //a_fc1
+        if (dropout) {
+            dropout->Forward(outputs_);
+            outputs_ = dropout->outputs_;
+        }
+        fc2.Forward(outputs_);
+
+        T fLoss, fLossSum = 0;
+        size_t nCorrected = 0;
+        matrix::Matrix<T> logits(fc2.n_neurons, 1, false);
+        fc2.grads_ = matrix::Matrix<T>(fc2.n_neurons, nBatch, false);
+        for (size_t b = 0; b < nBatch; ++b) {
+            for (size_t i = 0; i < fc2.n_neurons; ++i) {
+                logits(i, 0) = fc2.outputs_(i, b);
+            }
+            size_t nPred = __loss.Forward(logits, labels[b], fLoss);
+            fc2.grads_.setCol(b, __loss.grad_());
+            fLossSum += fLoss;
+            nCorrected += (nPred == labels[b]);
+        }
+        loss_ = fLossSum / (T)nBatch;
+        precision_ = nCorrected / (T)nBatch;
+
+        matrix::Matrix<T> act_grads = __act.grad_();
+        if (dropout) {
+            dropout->Backward(fc2.weights_.dot(fc2.grads_, true, false));
+            fc1.Backward(matrix::Matrix<T>(0, 0), dropout->grads_, act_grads);
+        } else {
+            fc1.Backward(fc2.weights_, fc2.grads_, act_grads);
+        }
+
+        fc1WeightsGrads = fc1.grads_.dot(batchImgs, false, true);
+        fc1BiasGrads = fc1.grads_.sum(1);
+        fc2WeightsGrads = fc2.grads_.dot(outputs_, false, true);
+        fc2BiasGrads = fc2.grads_.sum(1);
+    }
+
+    // applies the summed gradients of a batch of batch_size samples
+    void Update(T learning_rate, size_t batch_size) {
+        __opt.Update(fc1.weights_, fc1.bias_, fc1WeightsGrads, fc1BiasGrads, learning_rate / (T)batch_size);
+        __opt.Update(fc2.weights_, fc2.bias_, fc2WeightsGrads, fc2BiasGrads, learning_rate / (T)batch_size);
+    }
+
+    void Train(const matrix::Matrix<T> & batchImgs, const std::vector<size_t> & labels, T learning_rate) {
+        Backward(batchImgs, labels);
+        Update(learning_rate, labels.size());
+    }
+
+    DenseLayer<T> & fc1;
+    DenseLayer<T> & fc2;
+    DropoutLayer<T> * dropout;
+    matrix::Matrix<T> fc1WeightsGrads;
+    matrix::Matrix<T> fc1BiasGrads;
+    matrix::Matrix<T> fc2WeightsGrads;
+    matrix::Matrix<T> fc2BiasGrads;
+    T loss_; // mean loss of the last batch
+    T precision_; // precision of the last batch
+
+private:
+    __Act<T> __act;
+    SoftMaxLoss<T> __loss;
+    GradientDescent<T> __opt;
+};
+
+#endif //DEEP_LEARNING_MINIBATCH_H
@@ -20,4 +20,14 @@ public:
     }
 };
 
+// Rescales grads_ in place so that its L2 norm is at most max_norm; returns the norm before clipping.
+template <typename T>
+T ClipGradNorm(matrix::Matrix<T> & grads_, T max_norm) {
+    T norm = grads_.norm();
+    if (norm > max_norm) {
+        grads_ *= max_norm / norm;
+    }
+    return norm;
+}
+
 #endif //DEEP_LEARNING_OPTIMIZATION_H
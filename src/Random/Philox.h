@@ -0,0 +1,180 @@
+#ifndef DEEP_LEARNING_PHILOX_H
+#define DEEP_LEARNING_PHILOX_H
+
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "../Matrix.h"
+
+// Counter-based random numbers (Philox4x32-10, Salmon et al., SC'11).
+//
+// A draw is a pure function of (seed, stream, index): there is no generator state to
+// share or to advance, so any thread can produce any element and a buffer filled by
+// one thread or by sixteen holds exactly the same numbers. Streams separate the uses
+// of one seed (one per layer, per epoch, per dropout call...).
+namespace rng {
+    class Philox {
+    public:
+        static const size_t ROUNDS = 10;
+
+        explicit Philox(uint64_t seed) : key0((uint32_t)seed), key1((uint32_t)(seed >> 32)) {}
+
+        // the four 32-bit words of block 'counter' in 'stream'
+        inline void operator()(uint64_t stream, uint64_t counter, uint32_t out[4]) const {
+            uint32_t c0 = (uint32_t)counter, c1 = (uint32_t)(counter >> 32);
+            uint32_t c2 = (uint32_t)stream, c3 = (uint32_t)(stream >> 32);
+            uint32_t k0 = key0, k1 = key1;
+            for (size_t r = 0; r < ROUNDS; ++r) {
+                uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+                uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+                uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+                uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+                c1 = (uint32_t)p1;
+                c3 = (uint32_t)p0;
+                c0 = n0;
+                c2 = n2;
+                k0 += 0x9E3779B9u;
+                k1 += 0xBB67AE85u;
+            }
+            out[0] = c0;
+            out[1] = c1;
+            out[2] = c2;
+            out[3] = c3;
+        }
+
+        // Fills out[0, n) with the 32-bit words begin, begin + 1, ... of 'stream'. Blocks
+        // are computed LANES at a time with the rounds outermost, so the 32x32->64
+        // multiplies of independent counters vectorize.
+        void Fill(uint64_t stream, uint64_t begin, uint32_t * out, size_t n) const {
+            static const size_t LANES = 8;
+            uint64_t block = begin / 4;
+            size_t skip = begin % 4, i = 0;
+            while (i < n) {
+                uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+                for (size_t l = 0; l < LANES; ++l) {
+                    c0[l] = (uint32_t)(block + l);
+                    c1[l] = (uint32_t)((block + l) >> 32);
+                    c2[l] = (uint32_t)stream;
+                    c3[l] = (uint32_t)(stream >> 32);
+                }
+                uint32_t k0 = key0, k1 = key1;
+                for (size_t r = 0; r < ROUNDS; ++r) {
+                    for (size_t l = 0; l < LANES; ++l) {
+                        uint64_t p0 = (uint64_t)0xD2511F53u * c0[l];
+                        uint64_t p1 = (uint64_t)0xCD9E8D57u * c2[l];
+                        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1[l] ^ k0;
+                        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3[l] ^ k1;
+                        c1[l] = (uint32_t)p1;
+                        c3[l] = (uint32_t)p0;
+                        c0[l] = n0;
+                        c2[l] = n2;
+                    }
+                    k0 += 0x9E3779B9u;
+                    k1 += 0xBB67AE85u;
+                }
+                for (size_t l = 0; l < LANES && i < n; ++l) {
+                    const uint32_t words[4] = {c0[l], c1[l], c2[l], c3[l]};
+                    for (size_t w = skip; w < 4 && i < n; ++w) {
+                        out[i++] = words[w];
+                    }
+                    skip = 0;
+                }
+                block += LANES;
+            }
+        }
+
+    private:
+        uint32_t key0, key1;
+    };
+
+    // [0, 1) with 24 random bits
+    template <typename T>
+    inline T ToUniform(uint32_t x) {
+        return (T)(x >> 8) * (T)(1.0 / 16777216.0);
+    }
+
+    namespace detail {
+        static const size_t CHUNK = 1 << 14;
+
+        // calls fill(begin, end) over fixed CHUNK-sized pieces of [0, n) on n_threads threads
+        template <typename __Fill>
+        void Parallel(size_t n, size_t n_threads, __Fill fill) {
+            size_t nChunks = (n + CHUNK - 1) / CHUNK;
+            if (n_threads == 0) {
+                n_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+            }
+            n_threads = std::min(n_threads, nChunks);
+            auto work = [&](size_t t) {
+                for (size_t c = t; c < nChunks; c += n_threads) {
+                    fill(c * CHUNK, std::min(n, (c + 1) * CHUNK));
+                }
+            };
+            if (n_threads <= 1) {
+                work(0);
+                return;
+            }
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < n_threads; ++t) {
+                workers.emplace_back(work, t);
+            }
+            work(0);
+            for (auto & worker : workers) {
+                worker.join();
+            }
+        }
+    }
+
+    // out[i] = uniform in [low, high) drawn from word i of 'stream'
+    template <typename T>
+    void FillUniform(T * out, size_t n, T low, T high, uint64_t seed, uint64_t stream, size_t n_threads=0) {
+        Philox philox(seed);
+        detail::Parallel(n, n_threads, [&](size_t begin, size_t end) {
+            std::vector<uint32_t> words(end - begin);
+            philox.Fill(stream, begin, words.data(), words.size());
+            for (size_t i = begin; i < end; ++i) {
+                out[i] = low + (high - low) * ToUniform<T>(words[i - begin]);
+            }
+        });
+    }
+
+    // out[i] = normal(mean, stddev) by Box-Muller on words 2 * (i / 2) and 2 * (i / 2) + 1
+    template <typename T>
+    void FillNormal(T * out, size_t n, T mean, T stddev, uint64_t seed, uint64_t stream, size_t n_threads=0) {
+        Philox philox(seed);
+        const T twoPi = (T)6.283185307179586;
+        // chunks hold an even number of elements, so pairs never straddle two threads
+        detail::Parallel(n, n_threads, [&](size_t begin, size_t end) {
+            std::vector<uint32_t> words(end - begin + 1);
+            philox.Fill(stream, begin, words.data(), words.size());
+            for (size_t i = begin; i < end; i += 2) {
+                T u1 = ToUniform<T>(words[i - begin]) + (T)(1.0 / 16777216.0); // (0, 1]
+                T u2 = ToUniform<T>(words[i - begin + 1]);
+                T radius = stddev * std::sqrt(-2 * std::log(u1));
+                out[i] = mean + radius * std::cos(twoPi * u2);
+                if (i + 1 < end) {
+                    out[i + 1] = mean + radius * std::sin(twoPi * u2);
+                }
+            }
+        });
+    }
+
+    template <typename T>
+    matrix::Matrix<T> Uniform(size_t nrow, size_t ncol, T low, T high, uint64_t seed, uint64_t stream,
+                              size_t n_threads=0) {
+        matrix::Matrix<T> res(nrow, ncol, false);
+        FillUniform(res.data(), res.size, low, high, seed, stream, n_threads);
+        return res;
+    }
+
+    template <typename T>
+    matrix::Matrix<T> Normal(size_t nrow, size_t ncol, T mean, T stddev, uint64_t seed, uint64_t stream,
+                             size_t n_threads=0) {
+        matrix::Matrix<T> res(nrow, ncol, false);
+        FillNormal(res.data(), res.size, mean, stddev, seed, stream, n_threads);
+        return res;
+    }
+}
+
+#endif //DEEP_LEARNING_PHILOX_H
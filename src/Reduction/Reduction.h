@@ -0,0 +1,517 @@
+#ifndef DEEP_LEARNING_REDUCTION_H
+#define DEEP_LEARNING_REDUCTION_H
+
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+
+// SIMD-friendly reductions over raw buffers; chunked so results do not depend on the thread count.
+namespace reduction {
+    enum Accumulation {
+        Naive,    // lane-wise running sums
+        Pairwise, // recursive halving down to blocks of BLOCK elements, O(log n) error growth
+        Kahan     // lane-wise compensated sums, O(1) error growth
+    };
+
+    static const size_t LANES = 8;
+    static const size_t BLOCK = 128;
+    static const size_t CHUNK = 1 << 15;
+    static const size_t TILE_COLS = 64;
+
+    // number of threads used for inputs of more than one chunk; 0 means all cores
+    inline size_t & Threads() {
+        static size_t threads = 0;
+        return threads;
+    }
+
+    namespace detail {
+        template <typename T>
+        T SumNaive(const T * x, size_t n) {
+            T acc[LANES] = {};
+            size_t i = 0;
+            for (; i + LANES <= n; i += LANES) {
+                for (size_t l = 0; l < LANES; ++l) {
+                    acc[l] += x[i + l];
+                }
+            }
+            for (; i < n; ++i) {
+                acc[0] += x[i];
+            }
+            for (size_t w = LANES / 2; w > 0; w /= 2) {
+                for (size_t l = 0; l < w; ++l) {
+                    acc[l] += acc[l + w];
+                }
+            }
+            return acc[0];
+        }
+
+        template <typename T>
+        T SumPairwise(const T * x, size_t n) {
+            if (n <= BLOCK) {
+                return SumNaive(x, n);
+            }
+            size_t half = n / 2 / LANES * LANES;
+            return SumPairwise(x, half) + SumPairwise(x + half, n - half);
+        }
+
+        template <typename T>
+        T SumKahan(const T * x, size_t n) {
+            T acc[LANES] = {}, comp[LANES] = {};
+            size_t i = 0;
+            for (; i + LANES <= n; i += LANES) {
+                for (size_t l = 0; l < LANES; ++l) {
+                    T y = x[i + l] - comp[l];
+                    T t = acc[l] + y;
+                    comp[l] = (t - acc[l]) - y;
+                    acc[l] = t;
+                }
+            }
+            T sum = 0, c = 0;
+            for (size_t l = 0; l < LANES; ++l) {
+                T y = acc[l] - (comp[l] + c);
+                T t = sum + y;
+                c = (t - sum) - y;
+                sum = t;
+            }
+            for (; i < n; ++i) {
+                T y = x[i] - c;
+                T t = sum + y;
+                c = (t - sum) - y;
+                sum = t;
+            }
+            return sum;
+        }
+
+        template <typename T>
+        T Sum(const T * x, size_t n, Accumulation acc) {
+            switch (acc) {
+                case Naive:
+                    return SumNaive(x, n);
+                case Kahan:
+                    return SumKahan(x, n);
+                default:
+                    return SumPairwise(x, n);
+            }
+        }
+
+        template <typename T>
+        T SumSquares(const T * x, size_t n) {
+            T acc[LANES] = {};
+            size_t i = 0;
+            for (; i + LANES <= n; i += LANES) {
+                for (size_t l = 0; l < LANES; ++l) {
+                    acc[l] += x[i + l] * x[i + l];
+                }
+            }
+            for (; i < n; ++i) {
+                acc[0] += x[i] * x[i];
+            }
+            return SumNaive(acc, LANES);
+        }
+
+        // (value, index) of the first maximum (Greater) or minimum (Less) of x[0, n)
+        template <typename T, typename __Compare>
+        std::pair<T, size_t> Extremum(const T * x, size_t n, __Compare better) {
+            assert(n != 0);
+            T best[LANES];
+            size_t index[LANES];
+            size_t nLanes = std::min(n, LANES);
+            for (size_t l = 0; l < nLanes; ++l) {
+                best[l] = x[l];
+                index[l] = l;
+            }
+            size_t i = nLanes;
+            for (; i + LANES <= n; i += LANES) {
+                for (size_t l = 0; l < LANES; ++l) {
+                    // branch-free select keeps the loop vectorizable
+                    bool take = better(x[i + l], best[l]);
+                    best[l] = take ? x[i + l] : best[l];
+                    index[l] = take ? i + l : index[l];
+                }
+            }
+            for (size_t l = 0; i < n; ++i, l = (l + 1) % nLanes) {
+                if (better(x[i], best[l])) {
+                    best[l] = x[i];
+                    index[l] = i;
+                }
+            }
+            size_t b = 0;
+            for (size_t l = 1; l < nLanes; ++l) {
+                if (better(best[l], best[b]) || (!better(best[b], best[l]) && index[l] < index[b])) {
+                    b = l;
+                }
+            }
+            return std::make_pair(best[b], index[b]);
+        }
+
+        template <typename T>
+        struct Greater {
+            bool operator()(T a, T b) const {
+                return a > b;
+            }
+        };
+
+        template <typename T>
+        struct Less {
+            bool operator()(T a, T b) const {
+                return a < b;
+            }
+        };
+
+        // runs task(t) for every t in [0, n), spread round-robin over Threads() threads
+        template <typename __Task>
+        void ParallelFor(size_t n, __Task task) {
+            size_t nThreads = Threads() ? Threads() : std::max<size_t>(1, std::thread::hardware_concurrency());
+            nThreads = std::min(nThreads, n);
+            if (nThreads <= 1) {
+                for (size_t t = 0; t < n; ++t) {
+                    task(t);
+                }
+                return;
+            }
+            auto work = [&](size_t w) {
+                for (size_t t = w; t < n; t += nThreads) {
+                    task(t);
+                }
+            };
+            std::vector<std::thread> workers;
+            for (size_t w = 1; w < nThreads; ++w) {
+                workers.emplace_back(work, w);
+            }
+            work(0);
+            for (auto & worker : workers) {
+                worker.join();
+            }
+        }
+
+        // runs chunk(c) for every CHUNK-sized piece of [0, n) and returns the partials in order
+        template <typename R, typename __Chunk>
+        std::vector<R> Chunked(size_t n, __Chunk chunk) {
+            std::vector<R> partials((n + CHUNK - 1) / CHUNK);
+            ParallelFor(partials.size(), [&](size_t c) {
+                partials[c] = chunk(c);
+            });
+            return partials;
+        }
+
+        // A (nrow, ncol) buffer cut into tiles of width columns and about CHUNK elements, the
+        // unit of work of the axis reductions. The cut depends only on the shape.
+        struct Tiles {
+            Tiles(size_t nrow, size_t ncol, size_t width)
+                    : nrow(nrow),
+                      ncol(ncol),
+                      width(std::max<size_t>(1, width)),
+                      height(std::max<size_t>(1, CHUNK / this->width)),
+                      nRowBlocks(std::max<size_t>(1, (nrow + height - 1) / height)),
+                      nColBlocks(std::max<size_t>(1, (ncol + this->width - 1) / this->width)) {}
+
+            // tile(r, c, rowBegin, rowEnd, colBegin, colEnd) for the tile of row block r and column block c
+            template <typename __Tile>
+            void Run(__Tile tile) const {
+                ParallelFor(nRowBlocks * nColBlocks, [&](size_t t) {
+                    size_t r = t / nColBlocks, c = t % nColBlocks;
+                    tile(r, c, r * height, std::min(nrow, (r + 1) * height), c * width, std::min(ncol, (c + 1) * width));
+                });
+            }
+
+            size_t nrow, ncol, width, height, nRowBlocks, nColBlocks;
+        };
+
+        // whole rows, unless a row is longer than one chunk
+        inline Tiles RowTiles(size_t nrow, size_t ncol) {
+            return Tiles(nrow, ncol, std::min(ncol, CHUNK));
+        }
+
+        // at least TILE_COLS columns, so every tile streams whole cache lines of each row
+        inline Tiles ColTiles(size_t nrow, size_t ncol) {
+            return Tiles(nrow, ncol, std::min(ncol, std::max(TILE_COLS, CHUNK / std::max<size_t>(1, nrow))));
+        }
+
+        // out[i] = combine(reduce(piece, n, offset) of every piece of row i), pieces in order
+        template <typename R, typename T, typename __Reduce, typename __Combine>
+        void ReduceRows(const T * x, size_t nrow, size_t ncol, R * out, __Reduce reduce, __Combine combine) {
+            Tiles tiles = RowTiles(nrow, ncol);
+            const size_t nPieces = tiles.nColBlocks;
+            std::vector<R> partials(nPieces > 1 ? nrow * nPieces : 0);
+            tiles.Run([&](size_t, size_t c, size_t rowBegin, size_t rowEnd, size_t colBegin, size_t colEnd) {
+                for (size_t i = rowBegin; i < rowEnd; ++i) {
+                    R res = reduce(x + i * ncol + colBegin, colEnd - colBegin, colBegin);
+                    if (nPieces > 1) {
+                        partials[i * nPieces + c] = res;
+                    } else {
+                        out[i] = res;
+                    }
+                }
+            });
+            if (nPieces > 1) {
+                for (size_t i = 0; i < nrow; ++i) {
+                    out[i] = combine(partials.data() + i * nPieces, nPieces);
+                }
+            }
+        }
+
+        // Column sums of an (nrow, ncol) block whose rows are stride apart. Rows are added to
+        // out one after the other, which streams x once and vectorizes along the columns.
+        template <typename T>
+        void SumCols(const T * x, size_t nrow, size_t ncol, size_t stride, T * out, Accumulation acc) {
+            if (acc == Naive || nrow <= BLOCK) {
+                std::fill(out, out + ncol, T(0));
+                for (size_t i = 0; i < nrow; ++i) {
+                    const T * row = x + i * stride;
+                    for (size_t j = 0; j < ncol; ++j) {
+                        out[j] += row[j];
+                    }
+                }
+            } else if (acc == Kahan) {
+                std::vector<T> comp(ncol, 0);
+                std::fill(out, out + ncol, T(0));
+                for (size_t i = 0; i < nrow; ++i) {
+                    const T * row = x + i * stride;
+                    for (size_t j = 0; j < ncol; ++j) {
+                        T y = row[j] - comp[j];
+                        T t = out[j] + y;
+                        comp[j] = (t - out[j]) - y;
+                        out[j] = t;
+                    }
+                }
+            } else {
+                size_t half = nrow / 2;
+                std::vector<T> upper(ncol);
+                SumCols(x, half, ncol, stride, out, acc);
+                SumCols(x + half * stride, nrow - half, ncol, stride, upper.data(), acc);
+                for (size_t j = 0; j < ncol; ++j) {
+                    out[j] += upper[j];
+                }
+            }
+        }
+
+        template <typename T>
+        void SumSquaresCols(const T * x, size_t nrow, size_t ncol, size_t stride, T * out) {
+            std::fill(out, out + ncol, T(0));
+            for (size_t i = 0; i < nrow; ++i) {
+                const T * row = x + i * stride;
+                for (size_t j = 0; j < ncol; ++j) {
+                    out[j] += row[j] * row[j];
+                }
+            }
+        }
+
+        // first maximum (Greater) or minimum (Less) of every column of a strided block,
+        // with its row counted from firstRow
+        template <typename T, typename __Compare>
+        void ExtremumCols(const T * x, size_t nrow, size_t ncol, size_t stride, size_t firstRow,
+                          T * best, size_t * index, __Compare better) {
+            assert(nrow != 0);
+            std::copy(x, x + ncol, best);
+            std::fill(index, index + ncol, firstRow);
+            for (size_t i = 1; i < nrow; ++i) {
+                const T * row = x + i * stride;
+                for (size_t j = 0; j < ncol; ++j) {
+                    bool take = better(row[j], best[j]);
+                    best[j] = take ? row[j] : best[j];
+                    index[j] = take ? firstRow + i : index[j];
+                }
+            }
+        }
+
+        template <typename T, typename __Compare>
+        void ExtremumRows(const T * x, size_t nrow, size_t ncol, T * best, size_t * index, __Compare better) {
+            assert(ncol != 0);
+            std::vector<std::pair<T, size_t> > res(nrow);
+            ReduceRows(x, nrow, ncol, res.data(), [&](const T * piece, size_t n, size_t offset) {
+                auto r = Extremum(piece, n, better);
+                r.second += offset;
+                return r;
+            }, [&](const std::pair<T, size_t> * partials, size_t n) {
+                auto r = partials[0];
+                for (size_t p = 1; p < n; ++p) {
+                    if (better(partials[p].first, r.first)) {
+                        r = partials[p];
+                    }
+                }
+                return r;
+            });
+            for (size_t i = 0; i < nrow; ++i) {
+                best[i] = res[i].first;
+                index[i] = res[i].second;
+            }
+        }
+
+        template <typename T, typename __Compare>
+        void ExtremumCols(const T * x, size_t nrow, size_t ncol, T * best, size_t * index, __Compare better) {
+            assert(nrow != 0);
+            Tiles tiles = ColTiles(nrow, ncol);
+            const size_t nBlocks = tiles.nRowBlocks;
+            std::vector<T> bestPartials(nBlocks > 1 ? nBlocks * ncol : 0);
+            std::vector<size_t> indexPartials(bestPartials.size());
+            T * bestDst = nBlocks > 1 ? bestPartials.data() : best;
+            size_t * indexDst = nBlocks > 1 ? indexPartials.data() : index;
+            tiles.Run([&](size_t r, size_t, size_t rowBegin, size_t rowEnd, size_t colBegin, size_t colEnd) {
+                ExtremumCols(x + rowBegin * ncol + colBegin, rowEnd - rowBegin, colEnd - colBegin, ncol, rowBegin,
+                             bestDst + r * ncol + colBegin, indexDst + r * ncol + colBegin, better);
+            });
+            if (nBlocks > 1) {
+                // row blocks in order, so ties keep the first row
+                std::copy(bestPartials.begin(), bestPartials.begin() + ncol, best);
+                std::copy(indexPartials.begin(), indexPartials.begin() + ncol, index);
+                for (size_t r = 1; r < nBlocks; ++r) {
+                    for (size_t j = 0; j < ncol; ++j) {
+                        if (better(bestPartials[r * ncol + j], best[j])) {
+                            best[j] = bestPartials[r * ncol + j];
+                            index[j] = indexPartials[r * ncol + j];
+                        }
+                    }
+                }
+            }
+        }
+
+        template <typename T, typename __Compare>
+        std::pair<T, size_t> ChunkedExtremum(const T * x, size_t n, __Compare better) {
+            if (n <= CHUNK) {
+                return Extremum(x, n, better);
+            }
+            auto partials = Chunked<std::pair<T, size_t> >(n, [&](size_t c) {
+                size_t begin = c * CHUNK;
+                auto res = Extremum(x + begin, std::min(CHUNK, n - begin), better);
+                res.second += begin;
+                return res;
+            });
+            auto best = partials[0];
+            for (size_t c = 1; c < partials.size(); ++c) {
+                if (better(partials[c].first, best.first)) {
+                    best = partials[c];
+                }
+            }
+            return best;
+        }
+    }
+
+    template <typename T>
+    T Sum(const T * x, size_t n, Accumulation acc=Pairwise) {
+        if (n <= CHUNK) {
+            return detail::Sum(x, n, acc);
+        }
+        auto partials = detail::Chunked<T>(n, [&](size_t c) {
+            size_t begin = c * CHUNK;
+            return detail::Sum(x + begin, std::min(CHUNK, n - begin), acc);
+        });
+        return detail::Sum(partials.data(), partials.size(), acc);
+    }
+
+    template <typename T>
+    T Norm2(const T * x, size_t n) {
+        if (n <= CHUNK) {
+            return std::sqrt(detail::SumSquares(x, n));
+        }
+        auto partials = detail::Chunked<T>(n, [&](size_t c) {
+            size_t begin = c * CHUNK;
+            return detail::SumSquares(x + begin, std::min(CHUNK, n - begin));
+        });
+        return std::sqrt(detail::SumPairwise(partials.data(), partials.size()));
+    }
+
+    template <typename T>
+    T Max(const T * x, size_t n) {
+        return detail::ChunkedExtremum(x, n, detail::Greater<T>()).first;
+    }
+
+    template <typename T>
+    T Min(const T * x, size_t n) {
+        return detail::ChunkedExtremum(x, n, detail::Less<T>()).first;
+    }
+
+    // index of the first maximum
+    template <typename T>
+    size_t ArgMax(const T * x, size_t n) {
+        return detail::ChunkedExtremum(x, n, detail::Greater<T>()).second;
+    }
+
+    template <typename T>
+    size_t ArgMin(const T * x, size_t n) {
+        return detail::ChunkedExtremum(x, n, detail::Less<T>()).second;
+    }
+
+    // Axis reductions of a (nrow, ncol) buffer: ...Rows reduce every row into out[nrow], ...Cols
+    // every column into out[ncol]. Both are split over tiles of about CHUNK elements.
+    template <typename T>
+    void SumRows(const T * x, size_t nrow, size_t ncol, T * out, Accumulation acc=Pairwise) {
+        detail::ReduceRows(x, nrow, ncol, out, [&](const T * piece, size_t n, size_t) {
+            return detail::Sum(piece, n, acc);
+        }, [&](const T * partials, size_t n) {
+            return detail::Sum(partials, n, acc);
+        });
+    }
+
+    template <typename T>
+    void SumCols(const T * x, size_t nrow, size_t ncol, T * out, Accumulation acc=Pairwise) {
+        detail::Tiles tiles = detail::ColTiles(nrow, ncol);
+        const size_t nBlocks = tiles.nRowBlocks;
+        std::vector<T> partials(nBlocks > 1 ? nBlocks * ncol : 0);
+        T * dst = nBlocks > 1 ? partials.data() : out;
+        tiles.Run([&](size_t r, size_t, size_t rowBegin, size_t rowEnd, size_t colBegin, size_t colEnd) {
+            detail::SumCols(x + rowBegin * ncol + colBegin, rowEnd - rowBegin, colEnd - colBegin, ncol,
+                            dst + r * ncol + colBegin, acc);
+        });
+        if (nBlocks > 1) {
+            detail::SumCols(partials.data(), nBlocks, ncol, ncol, out, acc);
+        }
+    }
+
+    template <typename T>
+    void Norm2Rows(const T * x, size_t nrow, size_t ncol, T * out) {
+        detail::ReduceRows(x, nrow, ncol, out, [](const T * piece, size_t n, size_t) {
+            return detail::SumSquares(piece, n);
+        }, [](const T * partials, size_t n) {
+            return detail::SumPairwise(partials, n);
+        });
+        for (size_t i = 0; i < nrow; ++i) {
+            out[i] = std::sqrt(out[i]);
+        }
+    }
+
+    template <typename T>
+    void Norm2Cols(const T * x, size_t nrow, size_t ncol, T * out) {
+        detail::Tiles tiles = detail::ColTiles(nrow, ncol);
+        const size_t nBlocks = tiles.nRowBlocks;
+        std::vector<T> partials(nBlocks > 1 ? nBlocks * ncol : 0);
+        T * dst = nBlocks > 1 ? partials.data() : out;
+        tiles.Run([&](size_t r, size_t, size_t rowBegin, size_t rowEnd, size_t colBegin, size_t colEnd) {
+            detail::SumSquaresCols(x + rowBegin * ncol + colBegin, rowEnd - rowBegin, colEnd - colBegin, ncol,
+                                   dst + r * ncol + colBegin);
+        });
+        if (nBlocks > 1) {
+            detail::SumCols(partials.data(), nBlocks, ncol, ncol, out, Pairwise);
+        }
+        for (size_t j = 0; j < ncol; ++j) {
+            out[j] = std::sqrt(out[j]);
+        }
+    }
+
+    // max of every row with the column of its first occurrence
+    template <typename T>
+    void MaxRows(const T * x, size_t nrow, size_t ncol, T * max, size_t * index) {
+        detail::ExtremumRows(x, nrow, ncol, max, index, detail::Greater<T>());
+    }
+
+    template <typename T>
+    void MinRows(const T * x, size_t nrow, size_t ncol, T * min, size_t * index) {
+        detail::ExtremumRows(x, nrow, ncol, min, index, detail::Less<T>());
+    }
+
+    // max of every column with the row of its first occurrence
+    template <typename T>
+    void MaxCols(const T * x, size_t nrow, size_t ncol, T * max, size_t * index) {
+        detail::ExtremumCols(x, nrow, ncol, max, index, detail::Greater<T>());
+    }
+
+    template <typename T>
+    void MinCols(const T * x, size_t nrow, size_t ncol, T * min, size_t * index) {
+        detail::ExtremumCols(x, nrow, ncol, min, index, detail::Less<T>());
+    }
+}
+
+#endif //DEEP_LEARNING_REDUCTION_H
@@ -0,0 +1,56 @@
+#ifndef DEEP_LEARNING_LATENCY_H
+#define DEEP_LEARNING_LATENCY_H
+
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+namespace serving {
+    // Thread-safe latency histogram over the last `window` samples, in microseconds.
+    class LatencyRecorder {
+    public:
+        explicit LatencyRecorder(size_t window=1 << 16) : window(window), __count(0), __next(0) {}
+
+        void Record(double micros) {
+            std::lock_guard<std::mutex> lock(__mutex);
+            if (__samples.size() < window) {
+                __samples.push_back(micros);
+            } else {
+                __samples[__next] = micros;
+            }
+            __next = (__next + 1) % window;
+            ++__count;
+        }
+
+        // q-th quantile (0..1) of the recent samples, 0 if there are none
+        double Percentile(double q) const {
+            std::vector<double> samples;
+            {
+                std::lock_guard<std::mutex> lock(__mutex);
+                samples = __samples;
+            }
+            if (samples.empty()) {
+                return 0;
+            }
+            size_t k = std::min(samples.size() - 1, (size_t) (q * samples.size()));
+            std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+            return samples[k];
+        }
+
+        size_t Count() const {
+            std::lock_guard<std::mutex> lock(__mutex);
+            return __count;
+        }
+
+        size_t window;
+
+    private:
+        std::vector<double> __samples;
+        size_t __count;
+        size_t __next;
+        mutable std::mutex __mutex;
+    };
+}
+
+#endif //DEEP_LEARNING_LATENCY_H
@@ -0,0 +1,89 @@
+#ifndef DEEP_LEARNING_LOADGENERATOR_H
+#define DEEP_LEARNING_LOADGENERATOR_H
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <sstream>
+#include "Socket.h"
+#include "Latency.h"
+
+namespace serving {
+    struct LoadReport {
+        size_t n_requests;
+        size_t n_errors;
+        double seconds;
+        double p50_us;
+        double p99_us;
+
+        double Throughput() const {
+            return seconds > 0 ? n_requests / seconds : 0;
+        }
+
+        std::string ToString() const {
+            std::ostringstream line;
+            line << "requests=" << n_requests << " errors=" << n_errors
+                 << " p50_us=" << p50_us << " p99_us=" << p99_us
+                 << " throughput=" << Throughput() << "/s";
+            return line.str();
+        }
+    };
+
+    // Closed-loop client: n_clients connections, each sending n_requests lines taken
+    // round-robin from 'lines' and waiting for every answer before the next request, so
+    // the offered concurrency is exactly n_clients. Latency is measured end to end on
+    // the client side, socket round trip included.
+    class LoadGenerator {
+    public:
+        LoadGenerator(const std::string & endpoint, const std::vector<std::string> & lines)
+                : endpoint(endpoint), lines(lines) {}
+
+        LoadReport Run(size_t n_clients, size_t n_requests) {
+            LatencyRecorder latency(n_clients * n_requests);
+            std::atomic<size_t> nDone(0), nErrors(0);
+            auto client = [&](size_t c) {
+                int fd = Connect(endpoint);
+                LineReader reader(fd);
+                std::string answer;
+                for (size_t r = 0; r < n_requests; ++r) {
+                    const std::string & request = lines[(c * n_requests + r) % lines.size()];
+                    auto begin = std::chrono::steady_clock::now();
+                    if (!WriteAll(fd, request + "\n") || !reader.ReadLine(answer)) {
+                        ++nErrors;
+                        break;
+                    }
+                    latency.Record(std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - begin).count());
+                    if (answer.compare(0, 3, "ERR") == 0) {
+                        ++nErrors;
+                    }
+                    ++nDone;
+                }
+                close(fd);
+            };
+
+            auto begin = std::chrono::steady_clock::now();
+            std::vector<std::thread> clients;
+            for (size_t c = 0; c < n_clients; ++c) {
+                clients.emplace_back(client, c);
+            }
+            for (auto & thread : clients) {
+                thread.join();
+            }
+            LoadReport report;
+            report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            report.n_requests = nDone.load();
+            report.n_errors = nErrors.load();
+            report.p50_us = latency.Percentile(0.5);
+            report.p99_us = latency.Percentile(0.99);
+            return report;
+        }
+
+        std::string endpoint;
+        std::vector<std::string> lines;
+    };
+}
+
+#endif //DEEP_LEARNING_LOADGENERATOR_H
@@ -0,0 +1,362 @@
+#ifndef DEEP_LEARNING_PREDICTIONSERVER_H
+#define DEEP_LEARNING_PREDICTIONSERVER_H
+
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+#include <poll.h>
+#include <sys/stat.h>
+#include "Socket.h"
+#include "Latency.h"
+#include "../Matrix.h"
+#include "../Layer/DenseLayer.h"
+#include "../../data/preprocess.h"
+
+// Serves the test_dnn network over "B41 <digits>" / "RAW <floats>" / "STATS" lines, batching
+// queued images until max_batch are waiting or the oldest has waited latency_budget us.
+template <typename T, template <typename> class __Act>
+class PredictionServer {
+public:
+    PredictionServer(const DenseLayer<T> & fc1,
+                     const DenseLayer<T> & fc2,
+                     const std::string & endpoint,
+                     size_t max_batch=64,
+                     size_t latency_budget=2000)
+            : endpoint(endpoint),
+              max_batch(max_batch),
+              latency_budget(latency_budget),
+              img_area(fc1.last_n_neurons),
+              max_line(fc1.last_n_neurons * 64),
+              __fc1(fc1),
+              __fc2(fc2),
+              __listen_fd(-1),
+              __owns_socket(false),
+              __stopping(false),
+              __n_connections(0),
+              __n_requests(0),
+              __n_batches(0),
+              __n_errors(0) {}
+
+    ~PredictionServer() {
+        Stop();
+    }
+
+    PredictionServer(const PredictionServer &) = delete;
+    PredictionServer & operator=(const PredictionServer &) = delete;
+
+    // binds the endpoint and starts the accept and batcher threads
+    void Start() {
+        __listen_fd = serving::Listen(endpoint);
+        // remember which file we bound, so Stop never removes one it did not create
+        __owns_socket = !serving::IsTcp(endpoint) && lstat(endpoint.c_str(), &__socket) == 0;
+        __stopping = false;
+        __started = std::chrono::steady_clock::now();
+        __batcher = std::thread(&PredictionServer::BatchLoop, this);
+        __acceptor = std::thread(&PredictionServer::AcceptLoop, this);
+    }
+
+    // Prints Stats() every period_ms until Stop. Meant for a long-running daemon.
+    void Report(size_t period_ms) {
+        __reporter = std::thread([this, period_ms]() {
+            std::unique_lock<std::mutex> lock(__mutex);
+            while (!__cond.wait_for(lock, std::chrono::milliseconds(period_ms), [this]() { return __stopping.load(); })) {
+                lock.unlock();
+                std::cout << "[serve] " + Stats() + "\n" << std::flush;
+                lock.lock();
+            }
+        });
+    }
+
+    // closes the listening socket and every connection, answers what is queued, joins all threads
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            if (__stopping && __listen_fd < 0) {
+                return;
+            }
+            __stopping = true;
+        }
+        __cond.notify_all();
+        if (__acceptor.joinable()) {
+            __acceptor.join();
+        }
+        if (__listen_fd >= 0) {
+            close(__listen_fd);
+            __listen_fd = -1;
+            struct stat st;
+            if (__owns_socket && lstat(endpoint.c_str(), &st) == 0 &&
+                st.st_dev == __socket.st_dev && st.st_ino == __socket.st_ino) {
+                unlink(endpoint.c_str());
+            }
+            __owns_socket = false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(__conn_mutex);
+            for (int fd : __conn_fds) {
+                shutdown(fd, SHUT_RDWR);
+            }
+        }
+        for (auto & conn : __connections) {
+            conn.second.join();
+        }
+        __connections.clear();
+        __finished.clear();
+        if (__batcher.joinable()) {
+            __batcher.join();
+        }
+        if (__reporter.joinable()) {
+            __reporter.join();
+        }
+    }
+
+    // "requests=... batches=... mean_batch=... p50_us=... p99_us=... throughput=..." where
+    // the latencies run from a request being parsed to its answer being ready
+    std::string Stats() const {
+        size_t nRequests = __n_requests.load(), nBatches = __n_batches.load();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - __started).count();
+        std::ostringstream line;
+        line << "requests=" << nRequests
+             << " batches=" << nBatches
+             << " errors=" << __n_errors.load()
+             << " mean_batch=" << (nBatches ? (double)nRequests / nBatches : 0.0)
+             << " p50_us=" << __latency.Percentile(0.5)
+             << " p99_us=" << __latency.Percentile(0.99)
+             << " throughput=" << (seconds > 0 ? nRequests / seconds : 0.0) << "/s";
+        return line.str();
+    }
+
+    const serving::LatencyRecorder & Latency() const {
+        return __latency;
+    }
+
+    std::string endpoint;
+    size_t max_batch;
+    size_t latency_budget; // microseconds
+    size_t img_area;
+    size_t max_line; // longer lines drop the connection
+
+private:
+    typedef std::chrono::steady_clock __Clock;
+
+    struct __Request {
+        std::vector<T> image;
+        __Clock::time_point queued;
+        std::promise<std::string> answer;
+    };
+
+    void AcceptLoop() {
+        pollfd pfd = {__listen_fd, POLLIN, 0};
+        while (!__stopping) {
+            // a short timeout, so Stop never waits on accept
+            int ready = poll(&pfd, 1, 50);
+            Reap();
+            if (ready <= 0) {
+                continue;
+            }
+            int fd = accept(__listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            if (serving::IsTcp(endpoint)) {
+                int noDelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            }
+            {
+                std::lock_guard<std::mutex> lock(__conn_mutex);
+                __conn_fds.insert(fd);
+            }
+            size_t id = __n_connections++;
+            __connections[id] = std::thread(&PredictionServer::Serve, this, fd, id);
+        }
+    }
+
+    // joins the threads of the connections that have closed
+    void Reap() {
+        std::vector<size_t> finished;
+        {
+            std::lock_guard<std::mutex> lock(__conn_mutex);
+            finished.swap(__finished);
+        }
+        for (size_t id : finished) {
+            __connections[id].join();
+            __connections.erase(id);
+        }
+    }
+
+    // One connection: requests are answered in order, but the reader keeps parsing and
+    // queueing while earlier answers are pending, so a pipelining client fills batches.
+    void Serve(int fd, size_t id) {
+        serving::LineReader reader(fd, max_line);
+        std::deque<std::future<std::string> > pending;
+        std::string line, reply;
+        auto flush = [&](bool all) {
+            // write back every answer that is ready, or all of them
+            reply.clear();
+            while (!pending.empty() && (all || pending.front().wait_for(std::chrono::seconds(0)) ==
+                                               std::future_status::ready)) {
+                reply += pending.front().get();
+                reply += '\n';
+                pending.pop_front();
+            }
+            return reply.empty() || serving::WriteAll(fd, reply);
+        };
+        while (reader.ReadLine(line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            pending.push_back(Submit(line));
+            // keep parsing while the client has more lines in flight, and block for the
+            // answers only once it is waiting on them
+            if (!flush(!reader.Buffered())) {
+                break;
+            }
+        }
+        flush(true);
+        if (reader.Overflowed()) {
+            serving::WriteAll(fd, "ERR line too long\n");
+        }
+        std::lock_guard<std::mutex> lock(__conn_mutex);
+        __conn_fds.erase(fd);
+        close(fd);
+        __finished.push_back(id);
+    }
+
+    std::future<std::string> Submit(const std::string & line) {
+        std::unique_ptr<__Request> request(new __Request());
+        std::future<std::string> answer = request->answer.get_future();
+        std::string error;
+        if (line.compare(0, 4, "B41 ") == 0) {
+            if (line.size() - 4 < img_area / 2 * 3) {
+                error = "ERR short B41 image";
+            } else if (!DecodeImage(line.substr(4), img_area, request->image)) {
+                error = "ERR bad B41 digit";
+            }
+        } else if (line.compare(0, 4, "RAW ") == 0) {
+            std::istringstream in(line.substr(4));
+            T value;
+            while (request->image.size() <= img_area && in >> value) {
+                request->image.push_back(value);
+            }
+            if (request->image.size() != img_area) {
+                error = "ERR expected " + std::to_string(img_area) + " values";
+            }
+        } else if (line == "STATS") {
+            request->answer.set_value(Stats());
+            return answer;
+        } else {
+            error = "ERR unknown command";
+        }
+        if (!error.empty()) {
+            ++__n_errors;
+            request->answer.set_value(error);
+            return answer;
+        }
+
+        request->queued = __Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(__mutex);
+            if (__stopping) {
+                // the batcher may already be gone
+                request->answer.set_value("ERR server stopping");
+                return answer;
+            }
+            __queue.push_back(std::move(request));
+        }
+        __cond.notify_all();
+        return answer;
+    }
+
+    void BatchLoop() {
+        __Act<T> act;
+        std::vector<std::unique_ptr<__Request> > batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(__mutex);
+                __cond.wait(lock, [this]() { return !__queue.empty() || __stopping.load(); });
+                if (__queue.empty()) {
+                    return;
+                }
+                // the oldest request sets the deadline of the batch
+                auto deadline = __queue.front()->queued + std::chrono::microseconds(latency_budget);
+                __cond.wait_until(lock, deadline, [this]() { return __queue.size() >= max_batch || __stopping.load(); });
+                size_t n = std::min(max_batch, __queue.size());
+                for (size_t b = 0; b < n; ++b) {
+                    batch.push_back(std::move(__queue.front()));
+                    __queue.pop_front();
+                }
+            }
+            Predict(act, batch);
+            batch.clear();
+        }
+    }
+
+    void Predict(__Act<T> & act, std::vector<std::unique_ptr<__Request> > & batch) {
+        const size_t nBatch = batch.size();
+        matrix::Matrix<T> batchImgs(img_area, nBatch, false);
+        for (size_t b = 0; b < nBatch; ++b) {
+            for (size_t i = 0; i < img_area; ++i) {
+                batchImgs(i, b) = batch[b]->image[i];
+            }
+        }
+        __fc1.Forward(batchImgs);
+        __fc2.Forward(act.Forward(__fc1.outputs_));
+        const matrix::Matrix<T> & logits = __fc2.outputs_;
+        std::vector<size_t> preds = logits.argmax(0);
+
+        std::vector<T> probs(logits.nrow);
+        for (size_t b = 0; b < nBatch; ++b) {
+            T maxLogit = logits(preds[b], b), sum = 0;
+            for (size_t i = 0; i < logits.nrow; ++i) {
+                probs[i] = std::exp(logits(i, b) - maxLogit);
+                sum += probs[i];
+            }
+            std::ostringstream line;
+            line << preds[b];
+            for (size_t i = 0; i < logits.nrow; ++i) {
+                line << ' ' << probs[i] / sum;
+            }
+            batch[b]->answer.set_value(line.str());
+            __latency.Record(std::chrono::duration<double, std::micro>(__Clock::now() - batch[b]->queued).count());
+        }
+        __n_requests += nBatch;
+        ++__n_batches;
+    }
+
+    DenseLayer<T> __fc1; // owned by the batcher thread
+    DenseLayer<T> __fc2;
+    int __listen_fd;
+    bool __owns_socket; // whether __socket is the socket file Start created
+    struct stat __socket;
+    std::atomic<bool> __stopping; // written under __mutex
+    std::deque<std::unique_ptr<__Request> > __queue; // guarded by __mutex
+    std::mutex __mutex;
+    std::condition_variable __cond;
+    std::unordered_set<int> __conn_fds; // guarded by __conn_mutex
+    std::vector<size_t> __finished; // ids of closed connections, guarded by __conn_mutex
+    std::mutex __conn_mutex;
+    std::unordered_map<size_t, std::thread> __connections; // only touched by the acceptor, then by Stop after joining it
+    size_t __n_connections;
+    std::thread __acceptor;
+    std::thread __batcher;
+    std::thread __reporter;
+    std::atomic<size_t> __n_requests;
+    std::atomic<size_t> __n_batches;
+    std::atomic<size_t> __n_errors;
+    serving::LatencyRecorder __latency;
+    __Clock::time_point __started;
+};
+
+#endif //DEEP_LEARNING_PREDICTIONSERVER_H
@@ -0,0 +1,208 @@
+#ifndef DEEP_LEARNING_SOCKET_H
+#define DEEP_LEARNING_SOCKET_H
+
+#include <string>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+// Minimal line-oriented helpers over stream sockets. An endpoint is either a Unix
+// domain socket path or "tcp:<port>" for a loopback-only TCP port.
+namespace serving {
+    inline sockaddr_un UnixAddress(const std::string & path) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("socket path too long: " + path);
+        }
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return addr;
+    }
+
+    // Removes what a crashed server left at path. Only a socket that refuses connections is
+    // stale; a live socket or any other kind of file is an error and is left alone.
+    inline void RemoveStaleSocket(const std::string & path) {
+        struct stat st;
+        if (lstat(path.c_str(), &st) < 0) {
+            if (errno == ENOENT) {
+                return;
+            }
+            throw std::runtime_error("stat " + path + ": " + std::strerror(errno));
+        }
+        if (!S_ISSOCK(st.st_mode)) {
+            throw std::runtime_error(path + " exists and is not a socket");
+        }
+        sockaddr_un addr = UnixAddress(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+        int res = connect(fd, (sockaddr *) &addr, sizeof(addr));
+        int err = errno;
+        close(fd);
+        if (res == 0) {
+            throw std::runtime_error(path + " is in use by a running server");
+        }
+        if (err != ECONNREFUSED) {
+            throw std::runtime_error("probe " + path + ": " + std::strerror(err));
+        }
+        if (unlink(path.c_str()) < 0 && errno != ENOENT) {
+            throw std::runtime_error("unlink " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    inline int ListenUnix(const std::string & path, int backlog=128) {
+        sockaddr_un addr = UnixAddress(path);
+        RemoveStaleSocket(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+        if (bind(fd, (sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, backlog) < 0) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("listen on " + path + ": " + std::strerror(err));
+        }
+        return fd;
+    }
+
+    inline int ConnectUnix(const std::string & path) {
+        sockaddr_un addr = UnixAddress(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+        if (connect(fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("connect to " + path + ": " + std::strerror(err));
+        }
+        return fd;
+    }
+
+    inline sockaddr_in LoopbackAddress(int port) {
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t) port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return addr;
+    }
+
+    inline int ListenTcp(int port, int backlog=128) {
+        sockaddr_in addr = LoopbackAddress(port);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(fd, (sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, backlog) < 0) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("listen on port " + std::to_string(port) + ": " + std::strerror(err));
+        }
+        return fd;
+    }
+
+    inline int ConnectTcp(int port) {
+        sockaddr_in addr = LoopbackAddress(port);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+        if (connect(fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("connect to port " + std::to_string(port) + ": " + std::strerror(err));
+        }
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        return fd;
+    }
+
+    inline bool IsTcp(const std::string & endpoint) {
+        return endpoint.compare(0, 4, "tcp:") == 0;
+    }
+
+    inline int Listen(const std::string & endpoint) {
+        return IsTcp(endpoint) ? ListenTcp(std::stoi(endpoint.substr(4))) : ListenUnix(endpoint);
+    }
+
+    inline int Connect(const std::string & endpoint) {
+        return IsTcp(endpoint) ? ConnectTcp(std::stoi(endpoint.substr(4))) : ConnectUnix(endpoint);
+    }
+
+    inline bool WriteAll(int fd, const std::string & data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            done += (size_t) n;
+        }
+        return true;
+    }
+
+    // buffered reader of '\n'-terminated lines
+    class LineReader {
+    public:
+        // max_line = 0 reads lines of any length
+        explicit LineReader(int fd, size_t max_line=0) : fd(fd), max_line(max_line), __overflowed(false) {}
+
+        // false once the peer has closed the connection, or sent more than max_line bytes without a newline
+        bool ReadLine(std::string & line) {
+            while (true) {
+                size_t end = __buffer.find('\n');
+                if (end != std::string::npos) {
+                    line.assign(__buffer, 0, end);
+                    __buffer.erase(0, end + 1);
+                    return true;
+                }
+                if (max_line && __buffer.size() > max_line) {
+                    __overflowed = true;
+                    return false;
+                }
+                char chunk[4096];
+                ssize_t n = read(fd, chunk, sizeof(chunk));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                __buffer.append(chunk, (size_t) n);
+            }
+        }
+
+        // whether a whole line is already buffered, i.e. ReadLine will not block
+        bool Buffered() const {
+            return __buffer.find('\n') != std::string::npos;
+        }
+
+        bool Overflowed() const {
+            return __overflowed;
+        }
+
+        int fd;
+        size_t max_line;
+
+    private:
+        std::string __buffer;
+        bool __overflowed;
+    };
+}
+
+#endif //DEEP_LEARNING_SOCKET_H
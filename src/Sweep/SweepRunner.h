@@ -0,0 +1,390 @@
+#ifndef DEEP_LEARNING_SWEEPRUNNER_H
+#define DEEP_LEARNING_SWEEPRUNNER_H
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+#include "../Matrix.h"
+#include "../Loss/Loss.h"
+#include "../Layer/DenseLayer.h"
+#include "../ActiveFunc/ActiveFun.h"
+#include "../Random/Philox.h"
+
+enum Activation {
+    SIGMOID, TANH, RELU
+};
+
+// one hyperparameter variant of the test_dnn network
+template <typename T>
+struct SweepConfig {
+    T learning_rate;
+    size_t hidden;
+    Activation activation;
+};
+
+// Trains K variants of the test_dnn network on the same batches: the first layers are
+// stacked into one GEMM, the second layers of models with the same width are batched.
+template <typename T>
+class SweepRunner {
+public:
+    SweepRunner(const std::vector<SweepConfig<T> > & configs,
+                size_t n_inputs,
+                size_t n_outputs,
+                uint64_t seed,
+                size_t n_threads=0)
+            : n_inputs(n_inputs),
+              n_outputs(n_outputs),
+              n_threads(n_threads ? n_threads : std::max<size_t>(1, std::thread::hardware_concurrency())),
+              fc1_(n_inputs, TotalHidden(configs)),
+              __pool(std::min(this->n_threads, configs.size())) {
+        size_t offset = 0;
+        std::map<size_t, std::vector<__Model *> > byHidden;
+        for (size_t m = 0; m < configs.size(); ++m) {
+            const SweepConfig<T> & config = configs[m];
+            // four Philox streams per model, so a model's initial weights depend only on its position
+            fc1_.weights_.setRows(offset, rng::Normal<T>(config.hidden, n_inputs, 0, 0.1, seed, 4 * m));
+            fc1_.bias_.setRows(offset, rng::Normal<T>(config.hidden, 1, 0, 0.1, seed, 4 * m + 1));
+            __models.emplace_back(new __Model(config, offset, n_outputs));
+            __models.back()->fc2.weights_ = rng::Normal<T>(n_outputs, config.hidden, 0, 0.1, seed, 4 * m + 2);
+            __models.back()->fc2.bias_ = rng::Normal<T>(n_outputs, 1, 0, 0.1, seed, 4 * m + 3);
+            byHidden[config.hidden].push_back(__models.back().get());
+            offset += config.hidden;
+        }
+        for (auto & group : byHidden) {
+            __groups.push_back(group.second);
+        }
+    }
+
+    // n_steps mini-batch updates; every model sees the same batches
+    void Train(const matrix::Matrix<T> & x_train,
+               const matrix::Matrix<T> & y_train,
+               size_t n_steps,
+               size_t batch_size,
+               uint64_t seed) {
+        rng::Philox sampler(seed);
+        std::vector<uint32_t> draws(batch_size);
+        std::vector<size_t> labels(batch_size);
+        matrix::Matrix<T> batchImgs(batch_size, n_inputs, false);
+        matrix::Matrix<T> fc1Deltas(fc1_.n_neurons, batch_size, false);
+        for (auto & model : __models) {
+            model->Resize(batch_size);
+            model->loss_ = 0;
+            model->precision_ = 0;
+        }
+
+        for (size_t step = 0; step < n_steps; ++step) {
+            // shared pipeline: sample and gather the batch once for all models
+            sampler.Fill(0, step * batch_size, draws.data(), batch_size);
+            for (size_t b = 0; b < batch_size; ++b) {
+                size_t iImg = draws[b] % x_train.nrow;
+                batchImgs.setRow(b, x_train(iImg));
+                labels[b] = (size_t)y_train(iImg, 0);
+            }
+
+            // one GEMM for the first layer of every model
+            fc1_.Forward(batchImgs.t());
+            Forward2(batch_size);
+
+            ForEachModel([&](__Model & model) {
+                model.LossGrads(labels);
+            });
+            // deltas of the hidden layers, then the second-layer weight gradients
+            for (const __Group & group : __groups) {
+                const size_t hidden = group.front()->config.hidden;
+                GroupDot(group, hidden, batch_size, n_outputs,
+                         [](__Model & model) { return model.fc2.weights_.data(); }, true,
+                         [](__Model & model) { return model.fc2Deltas.data(); }, false,
+                         [](__Model & model) { return model.hiddenDeltas.data(); });
+                GroupDot(group, n_outputs, hidden, batch_size,
+                         [](__Model & model) { return model.fc2Deltas.data(); }, false,
+                         [](__Model & model) { return model.outputs_.data(); }, true,
+                         [](__Model & model) { return model.fc2WeightsGrads.data(); });
+            }
+            ForEachModel([&](__Model & model) {
+                fc1Deltas.setRows(model.offset, model.hiddenDeltas * model.act->grad_());
+                model.Update(batch_size);
+            });
+
+            // and one GEMM for all their first-layer weight gradients
+            matrix::Matrix<T> fc1WeightsGrads = fc1Deltas.dot(batchImgs);
+            matrix::Matrix<T> fc1BiasGrads = fc1Deltas.sum(1);
+            for (auto & model : __models) {
+                T scale = model->config.learning_rate / (T)batch_size;
+                size_t begin = model->offset * n_inputs, end = (model->offset + model->config.hidden) * n_inputs;
+                T * weights = fc1_.weights_.data();
+                const T * grads = fc1WeightsGrads.data();
+                for (size_t i = begin; i < end; ++i) {
+                    weights[i] -= scale * grads[i];
+                }
+                for (size_t i = model->offset; i < model->offset + model->config.hidden; ++i) {
+                    fc1_.bias_(i, 0) -= scale * fc1BiasGrads(i, 0);
+                }
+            }
+        }
+
+        for (auto & model : __models) {
+            model->loss_ /= (T)(n_steps * batch_size);
+            model->precision_ /= (T)(n_steps * batch_size);
+        }
+    }
+
+    // test accuracy of every model, from one batched forward pass over x_test
+    std::vector<T> Evaluate(const matrix::Matrix<T> & x_test, const std::vector<T> & y_test) {
+        for (auto & model : __models) {
+            model->Resize(x_test.nrow);
+        }
+        fc1_.Forward(x_test.t());
+        Forward2(x_test.nrow);
+
+        std::vector<T> accuracy(__models.size());
+        for (size_t m = 0; m < __models.size(); ++m) {
+            std::vector<size_t> preds = __models[m]->fc2.outputs_.argmax(0);
+            size_t nCorrected = 0;
+            for (size_t i = 0; i < preds.size(); ++i) {
+                nCorrected += (preds[i] == (size_t)y_test[i]);
+            }
+            accuracy[m] = nCorrected / (T)preds.size();
+        }
+        return accuracy;
+    }
+
+    size_t size() const {
+        return __models.size();
+    }
+
+    const SweepConfig<T> & config(size_t m) const {
+        return __models[m]->config;
+    }
+
+    // mean training loss / precision of model m over the last Train
+    T loss(size_t m) const {
+        return __models[m]->loss_;
+    }
+
+    T precision(size_t m) const {
+        return __models[m]->precision_;
+    }
+
+    size_t n_inputs;
+    size_t n_outputs;
+    size_t n_threads;
+    DenseLayer<T> fc1_; // the stacked first layers of all models
+
+private:
+    struct __Model {
+        __Model(const SweepConfig<T> & config, size_t offset, size_t n_outputs)
+                : config(config),
+                  offset(offset),
+                  fc2(config.hidden, n_outputs),
+                  outputs_(0, 0),
+                  fc2Deltas(0, 0),
+                  hiddenDeltas(0, 0),
+                  fc2WeightsGrads(n_outputs, config.hidden, false),
+                  loss_(0),
+                  precision_(0) {
+            switch (config.activation) {
+                case SIGMOID:
+                    act.reset(new Sigmoid<T>());
+                    break;
+                case RELU:
+                    act.reset(new ReLU<T>());
+                    break;
+                default:
+                    act.reset(new Tanh<T>());
+            }
+        }
+
+        // sizes the per-batch buffers that the batched GEMMs write into
+        void Resize(size_t batch_size) {
+            if (fc2Deltas.ncol != batch_size) {
+                fc2.outputs_ = matrix::Matrix<T>(fc2.n_neurons, batch_size, false);
+                fc2Deltas = matrix::Matrix<T>(fc2.n_neurons, batch_size, false);
+                hiddenDeltas = matrix::Matrix<T>(config.hidden, batch_size, false);
+            }
+        }
+
+        // softmax loss of every column of fc2.outputs_, and its gradient in fc2Deltas
+        void LossGrads(const std::vector<size_t> & labels) {
+            T fLoss;
+            matrix::Matrix<T> logits(fc2.n_neurons, 1, false);
+            for (size_t b = 0; b < labels.size(); ++b) {
+                for (size_t i = 0; i < fc2.n_neurons; ++i) {
+                    logits(i, 0) = fc2.outputs_(i, b);
+                }
+                size_t nPred = loss.Forward(logits, labels[b], fLoss);
+                fc2Deltas.setCol(b, loss.grad_());
+                loss_ += fLoss;
+                precision_ += (nPred == labels[b]);
+            }
+        }
+
+        void Update(size_t batch_size) {
+            T scale = config.learning_rate / (T)batch_size;
+            fc2.weights_ -= fc2WeightsGrads * scale;
+            fc2.bias_ -= fc2Deltas.sum(1) * scale;
+        }
+
+        SweepConfig<T> config;
+        size_t offset; // first row of this model in the stacked first layer
+        DenseLayer<T> fc2;
+        std::unique_ptr<ActiveFun<T> > act;
+        SoftMaxLoss<T> loss;
+        matrix::Matrix<T> outputs_; //a_fc1
+        matrix::Matrix<T> fc2Deltas;
+        matrix::Matrix<T> hiddenDeltas; // fc2 weights^T * fc2Deltas
+        matrix::Matrix<T> fc2WeightsGrads;
+        T loss_;
+        T precision_;
+    };
+
+    typedef std::vector<__Model *> __Group; // models with the same hidden width
+
+    // Persistent workers for the per-model work; Run(n, fn) calls fn(0) ... fn(n - 1) on
+    // the workers and the calling thread and returns once all of them are done.
+    class __Pool {
+    public:
+        explicit __Pool(size_t n_threads)
+                : __fn(nullptr), __n(0), __next(0), __n_finished(0), __generation(0), __stopping(false) {
+            for (size_t t = 1; t < n_threads; ++t) {
+                __workers.emplace_back(&__Pool::Loop, this);
+            }
+        }
+
+        ~__Pool() {
+            {
+                std::lock_guard<std::mutex> lock(__mutex);
+                __stopping = true;
+            }
+            __start.notify_all();
+            for (auto & worker : __workers) {
+                worker.join();
+            }
+        }
+
+        void Run(size_t n, const std::function<void(size_t)> & fn) {
+            if (__workers.empty() || n <= 1) {
+                for (size_t i = 0; i < n; ++i) {
+                    fn(i);
+                }
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(__mutex);
+                __fn = &fn;
+                __n = n;
+                __next = 0;
+                __n_finished = 0;
+                ++__generation;
+            }
+            __start.notify_all();
+            Work(fn, n);
+            // every worker checks in, so none can still be reading this call's fn afterwards
+            std::unique_lock<std::mutex> lock(__mutex);
+            __finished.wait(lock, [this]() { return __n_finished == __workers.size(); });
+        }
+
+    private:
+        void Work(const std::function<void(size_t)> & fn, size_t n) {
+            for (size_t i = __next.fetch_add(1); i < n; i = __next.fetch_add(1)) {
+                fn(i);
+            }
+        }
+
+        void Loop() {
+            size_t seen = 0;
+            while (true) {
+                const std::function<void(size_t)> * fn;
+                size_t n;
+                {
+                    std::unique_lock<std::mutex> lock(__mutex);
+                    __start.wait(lock, [&]() { return __stopping || __generation != seen; });
+                    if (__stopping) {
+                        return;
+                    }
+                    seen = __generation;
+                    fn = __fn;
+                    n = __n;
+                }
+                Work(*fn, n);
+                {
+                    std::lock_guard<std::mutex> lock(__mutex);
+                    ++__n_finished;
+                }
+                __finished.notify_one();
+            }
+        }
+
+        const std::function<void(size_t)> * __fn;
+        size_t __n;
+        std::atomic<size_t> __next;
+        size_t __n_finished;
+        size_t __generation;
+        bool __stopping;
+        std::vector<std::thread> __workers;
+        std::mutex __mutex;
+        std::condition_variable __start;
+        std::condition_variable __finished;
+    };
+
+    static size_t TotalHidden(const std::vector<SweepConfig<T> > & configs) {
+        size_t total = 0;
+        for (auto & config : configs) {
+            total += config.hidden;
+        }
+        return total;
+    }
+
+    template <typename __Fn>
+    void ForEachModel(__Fn fn) {
+        __pool.Run(__models.size(), [&](size_t m) {
+            fn(*__models[m]);
+        });
+    }
+
+    // C = op(A) * op(B), of the same (M, N, K) for every model of the group, as one batched GEMM
+    template <typename __A, typename __B, typename __C>
+    void GroupDot(const __Group & group, size_t M, size_t N, size_t K,
+                  __A a, bool transA, __B b, bool transB, __C c) {
+        std::vector<const T *> as, bs;
+        std::vector<T *> cs;
+        for (__Model * model : group) {
+            as.push_back(a(*model));
+            bs.push_back(b(*model));
+            cs.push_back(c(*model));
+        }
+        gemm::BatchedDot(group.size(), M, N, K, as.data(), transA, bs.data(), transB, cs.data(),
+                         [this](size_t n, const std::function<void(size_t)> & fn) { __pool.Run(n, fn); });
+    }
+
+    // activations and second layers of every model on the stacked first-layer outputs
+    void Forward2(size_t batch_size) {
+        ForEachModel([&](__Model & model) {
+            model.outputs_ = model.act->Forward(fc1_.outputs_.rows(model.offset, model.offset + model.config.hidden));
+        });
+        for (const __Group & group : __groups) {
+            GroupDot(group, n_outputs, batch_size, group.front()->config.hidden,
+                     [](__Model & model) { return model.fc2.weights_.data(); }, false,
+                     [](__Model & model) { return model.outputs_.data(); }, false,
+                     [](__Model & model) { return model.fc2.outputs_.data(); });
+        }
+        ForEachModel([&](__Model & model) {
+            for (size_t i = 0; i < n_outputs; ++i) {
+                for (size_t b = 0; b < batch_size; ++b) {
+                    model.fc2.outputs_(i, b) += model.fc2.bias_(i, 0);
+                }
+            }
+        });
+    }
+
+    std::vector<std::unique_ptr<__Model> > __models;
+    std::vector<__Group> __groups;
+    __Pool __pool;
+};
+
+#endif //DEEP_LEARNING_SWEEPRUNNER_H